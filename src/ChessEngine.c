@@ -1,261 +1,724 @@
-#include "a_header.h"
+#include "chessEngine.h"
 #include "chessEngineBrain.h"
+#include <math.h>
 
-int engine_move(Game *game)
+// Plays the engine's chosen move on the real board (the caller passes the turn)
+static void execute_engine_move(Game *game, const Move *best_move)
 {
-    // Start timing
-    clock_t start = clock();
-    long long positions_counted = 0;
-    int engine_color = game->human_color == 1 ? 0 : 1;
-    const int SEARCH_DEPTH = 3; // 0 is min depth (only root node)
+    move(game, best_move->origin, best_move->target);
 
-    SearchResult best_result;
+    if (best_move->promotion_piece != '.')
+    {
+        handle_promotion(&game->board, best_move->target, best_move->promotion_piece);
+    }
+}
+
+// Picks and plays a move for the side to move; the move is returned in played so the
+// caller can record it. history holds the game's earlier positions, the one moved from is
+// added to it. Returns 0 if there is no legal move.
+int engine_move(Game *game, KeyHistory *history, Move *played)
+{
+    const int SEARCH_DEPTH = 4; // plies, including the engine's own move
+
+    if (!has_legal_move(game))
+    {
+        return 0;
+    }
+
+    // Known opening positions are played straight from the book, without searching
+    if (book_probe(game->book, game, played))
+    {
+        char san[16];
+        move_to_san(game, played, san);
+        key_history_push(history, game);
+        execute_engine_move(game, played);
+
+        printf("\nEngine Move Analysis:\n");
+        printf("└─ Book move:               %s\n", san);
+        return 1;
+    }
+
+    SearchContext context;
+    memset(&context, 0, sizeof(SearchContext));
+    context.limits.depth = SEARCH_DEPTH;
+    context.params.futility_margin = DEFAULT_FUTILITY_MARGIN;
+    context.params.razor_margin = DEFAULT_RAZOR_MARGIN;
+    context.history = history;
+
+    Move best_move;
+    search_position(game, &context, &best_move);
+
+    // Execute the best move found
+    key_history_push(history, game);
+    execute_engine_move(game, &best_move);
+    *played = best_move;
+
+    // Print the best move and statistics
+    char notation1[3], notation2[3];
+    double time_spent = (current_time_ms() - context.start_time) / 1000.0;
+    position_to_notation(best_move.origin, notation1);
+    position_to_notation(best_move.target, notation2);
+
+    // Calculate additional statistics
+    long long positions_counted = context.positions_counted;
+    double positions_per_second = time_spent > 0 ? positions_counted / time_spent : 0;
+    int depth_reached = context.depth_reached;
+    double branching_factor = depth_reached > 0 ? pow(positions_counted, 1.0 / depth_reached) : 0;
+
+    printf("\nEngine Move Analysis:\n");
+    printf("├─ Search depth:            %d\n", depth_reached);
+    printf("├─ Best Move:               %s → %s %c\n", notation1, notation2, best_move.promotion_piece);
+
+    printf("├─ Positions analyzed:      %'lld\n", positions_counted);
+    printf("├─ Time spent:              %.3f seconds\n", time_spent);
+    printf("├─ Speed:                   %.0f positions/second\n", positions_per_second);
+    printf("├─ Futility pruned:         %'lld quiet moves\n", context.futility_pruned);
+    printf("├─ Razored:                 %'lld positions\n", context.razored);
+    printf("└─ Avg. branching factor:   %.1f\n", branching_factor);
+
+    printf("\nBest line:\n");
+    for (int i = 0; i < context.best_line.length; i++)
+    {
+        char from[3], to[3];
+        position_to_notation(context.best_line.moves[i].origin, from);
+        position_to_notation(context.best_line.moves[i].target, to);
+        printf("%d: %s → %s\n", i + 1, from, to);
+    }
+    return 1;
+}
+
+// Sets context->stop once the node or time budget is used up
+static void check_search_limits(SearchContext *context)
+{
+    if (context->limits.nodes > 0 && context->positions_counted >= context->limits.nodes)
+    {
+        context->stop = 1;
+    }
+    if (context->limits.move_time > 0 && current_time_ms() - context->start_time >= context->limits.move_time)
+    {
+        context->stop = 1;
+    }
+}
+
+// Prepends a move to the line found below it
+static void store_line(SearchResult *result, const Move *m, const SearchResult *child_result)
+{
+    int length = min(child_result->length, MAX_SEARCH_DEPTH - 1);
+
+    // Copy current move but clear the pointers
+    result->moves[0] = *m;
+    result->moves[0].next = NULL;
+    result->moves[0].prev = NULL;
 
-    if (game->possible_moves->size > 0)
+    // Copy the child's moves
+    memcpy(&result->moves[1], child_result->moves, length * sizeof(Move));
+    result->length = length + 1;
+}
+
+// Mate scores (and the infinite bounds) are exact, a margin on the evaluation means nothing next to them
+static int is_mate_score(int score)
+{
+    return score <= -MATE_IN_MAX_PLY || score >= MATE_IN_MAX_PLY;
+}
+
+// Score of a checkmate at ply, from white's view
+static int mated_score(int white_mated, int ply)
+{
+    int score = MATE_SCORE - min(ply, MAX_SEARCH_DEPTH);
+    return white_mated ? -score : score;
+}
+
+// The search counts mates from the root, the transposition table from the stored position,
+// so an entry is still right when the position comes up at another ply
+static int score_to_tt(int score, int ply)
+{
+    if (score >= MATE_IN_MAX_PLY)
+        return score + ply;
+    if (score <= -MATE_IN_MAX_PLY)
+        return score - ply;
+    return score;
+}
+
+static int score_from_tt(int score, int ply)
+{
+    if (score >= MATE_IN_MAX_PLY)
+        return score - ply;
+    if (score <= -MATE_IN_MAX_PLY)
+        return score + ply;
+    return score;
+}
+
+// Check extension: a move that gives check is searched a ply deeper, so a mating attack or a
+// perpetual isn't cut off at the horizon. A line can grow to twice the iteration's depth this way.
+static int check_extension(const Game *after, int depth, int ply, const SearchContext *context)
+{
+    return after->isCheck != -1 && ply + depth < min(2 * context->iteration_depth, MAX_SEARCH_DEPTH);
+}
+
+// A root move with what the last iteration found out about it, to order the next one
+typedef struct
+{
+    Move move;
+    int score;       // white's view; only the best move's is exact, the others are bounds
+    long long nodes; // positions in its subtree
+} RootMove;
+
+// Searches the root moves in the window (alpha, beta), keeping each one's score and subtree size.
+// Returns the index of the best move with its line, -1 if the search was stopped. The line's
+// score is only a bound if it falls outside the window.
+static int search_root(Game *game, RootMove *root_moves, int count, int depth, int alpha, int beta,
+                       SearchContext *context, SearchResult *line)
+{
+    int best_index = -1;
+    line->score = game->is_white_turn ? -1000000000 : 1000000000;
+
+    for (int i = 0; i < count; i++)
     {
-        Move *best_move = NULL;
-        int best_score = engine_color == 1 ? -1000000000 : 1000000000;
-        Move *current_move = game->possible_moves->head;
+        Game temp_game;
+        memcpy(&temp_game, game, sizeof(Game));
+        play_move(&temp_game, root_moves[i].move.origin, root_moves[i].move.target, root_moves[i].move.promotion_piece);
+
+        long long nodes_before = context->positions_counted;
+        int extension = check_extension(&temp_game, depth - 1, 1, context);
+        SearchResult result = minimax(&temp_game, depth - 1 + extension, 1, alpha, beta, context);
+        if (context->stop)
+        {
+            return -1;
+        }
+        root_moves[i].score = result.score;
+        root_moves[i].nodes = context->positions_counted - nodes_before;
 
-        // Try each possible move and use minimax to evaluate
-        while (current_move != NULL)
+        // Update best move based on the side to move
+        if ((game->is_white_turn && result.score > line->score) || (!game->is_white_turn && result.score < line->score))
         {
-            Game temp_game;
-            memcpy(&temp_game, game, sizeof(Game));
+            line->score = result.score;
+            store_line(line, &root_moves[i].move, &result);
+            best_index = i;
+        }
+
+        if (game->is_white_turn)
+            alpha = max(alpha, line->score);
+        else
+            beta = min(beta, line->score);
+        if (beta <= alpha)
+        {
+            break;
+        }
+    }
+    return best_index;
+}
+
+// Whether root move a goes before b in the next iteration: the better score for the side to move
+// first, and among equal scores the larger subtree, a move that took more to refute
+static int root_move_before(const RootMove *a, const RootMove *b, int white)
+{
+    if (a->score != b->score)
+    {
+        return white ? a->score > b->score : a->score < b->score;
+    }
+    return a->nodes > b->nodes;
+}
+
+// Orders the root moves after the first ones, which are ranked already, for the next iteration
+static void sort_root_moves(RootMove *root_moves, int count, int first, int white)
+{
+    for (int i = first + 1; i < count; i++)
+    {
+        RootMove current = root_moves[i];
+        int j = i;
+        while (j > first && root_move_before(&current, &root_moves[j - 1], white))
+        {
+            root_moves[j] = root_moves[j - 1];
+            j--;
+        }
+        root_moves[j] = current;
+    }
+}
+
+// Iterative deepening from the side to move until a limit in context->limits is reached.
+// context->best_line holds the line of the last completed iteration, scored from white's view,
+// and context->pv_lines the context->multi_pv best lines, each with its exact score.
+// Returns 0 if there is no legal move, 1 otherwise with the move to play in best_move.
+int search_position(Game *game, SearchContext *context, Move *best_move)
+{
+    context->start_time = current_time_ms();
+    context->positions_counted = 0;
+    context->futility_pruned = 0;
+    context->razored = 0;
+    context->depth_reached = 0;
+    context->best_line.length = 0;
+    context->best_line.score = 0;
+    context->num_pv_lines = 0;
+    memset(context->killers, 0, sizeof(context->killers));
+    context->keys[0] = position_key(game);
+
+    Move moves[MAX_MOVES];
+    int count = generate_legal_moves(game, game->is_white_turn, moves);
+    if (count == 0)
+    {
+        return 0;
+    }
+    *best_move = moves[0];
+
+    int max_depth = MAX_SEARCH_DEPTH;
+    if (context->limits.depth > 0 && context->limits.depth < max_depth)
+    {
+        max_depth = context->limits.depth;
+    }
+
+    int num_pv = min(max(context->multi_pv, 1), min(count, MAX_MULTI_PV));
+
+    // A stored earlier analysis counts as the iterations it already did; if it went deep
+    // enough the search is over before it started. It only knows the best line.
+    // Its results hold for the position alone, so it is left out when the search can repeat
+    // a position of the game before the root, and the fifty-move clock is part of the key.
+    int first_depth = 1;
+    int cacheable = context->history == NULL || context->history->count == 0 || game->reversible_plies == 0;
+    uint64_t key = context->keys[0] ^ (uint64_t)game->halfmove_clock * 0x9E3779B97F4A7C15ULL;
+    TTEntry cached;
+    if (cacheable && num_pv == 1 && analysis_cache_probe(context->cache, key, &cached) && cached.bound == TT_EXACT &&
+        tt_order_move(&cached, moves, count))
+    {
+        *best_move = moves[0];
+        context->best_line.moves[0] = moves[0];
+        context->best_line.length = 1;
+        context->best_line.score = cached.score;
+        context->pv_lines[0] = context->best_line;
+        context->num_pv_lines = 1;
+        context->depth_reached = cached.depth;
+        first_depth = is_mate_score(cached.score) ? max_depth + 1 : cached.depth + 1;
+
+        if (context->on_iteration != NULL)
+        {
+            context->on_iteration(context, context->user_data);
+        }
+    }
 
-            // Handle different move types (normal, promotion, castling)
-            if (current_move->promotion_piece != '.')
+    RootMove root_moves[MAX_MOVES];
+    for (int i = 0; i < count; i++)
+    {
+        root_moves[i].move = moves[i];
+        root_moves[i].score = 0;
+        root_moves[i].nodes = 0;
+    }
+
+    for (int depth = first_depth; depth <= max_depth && !context->stop; depth++)
+    {
+        context->iteration_depth = depth;
+
+        // With multi-PV, each pass finds the best of the moves the earlier passes left over
+        SearchResult lines[MAX_MULTI_PV];
+        int pv;
+        for (pv = 0; pv < num_pv; pv++)
+        {
+            // Aspiration window: the score seldom moves far from one iteration to the next, and a
+            // narrow window cuts off much more. A score outside it is only a bound, so the pass
+            // is searched again with the window widened on that side.
+            int delta = ASPIRATION_WINDOW;
+            int alpha = -1000000000;
+            int beta = 1000000000;
+            if (pv < context->num_pv_lines && !is_mate_score(context->pv_lines[pv].score))
             {
-                move(&temp_game, current_move->origin, current_move->target);
-                temp_game.board.promotion_tile = current_move->target;
-                handle_promotion(&temp_game.board, current_move->promotion_piece);
+                alpha = context->pv_lines[pv].score - delta;
+                beta = context->pv_lines[pv].score + delta;
             }
-            else if (handle_castling(&temp_game, get_piece_at_position(&game->board, current_move->origin), current_move->origin, current_move->target))
+
+            int best_index;
+            while ((best_index = search_root(game, root_moves + pv, count - pv, depth, alpha, beta, context, &lines[pv])) >= 0)
             {
-                move(&temp_game, current_move->origin, current_move->target);
+                int score = lines[pv].score;
+                delta *= 4;
+                if (score <= alpha)
+                    alpha = is_mate_score(score) ? -1000000000 : score - delta;
+                else if (score >= beta)
+                    beta = is_mate_score(score) ? 1000000000 : score + delta;
+                else
+                    break;
             }
-            else
+            if (best_index < 0)
             {
-                move(&temp_game, current_move->origin, current_move->target);
+                break;
             }
 
-            check_check(&temp_game);
-            check_checkmate(&temp_game);
-            toggle_turn(&temp_game);
+            // The move found takes its rank, the next pass leaves it out
+            RootMove found = root_moves[pv + best_index];
+            memmove(&root_moves[pv + 1], &root_moves[pv], best_index * sizeof(RootMove));
+            root_moves[pv] = found;
+        }
 
-            SearchResult result = minimax(&temp_game, SEARCH_DEPTH, -1000000000, 1000000000, &positions_counted);
-            int score = result.score;
+        // An interrupted iteration is thrown away, the previous one is complete
+        if (context->stop || pv < num_pv)
+        {
+            break;
+        }
 
-            // Update best move based on engine color
-            if ((engine_color == 1 && score > best_score) ||
-                (engine_color == 0 && score < best_score))
-            {
-                best_score = score;
-                best_move = current_move;
-                best_result = result;
-            }
+        *best_move = root_moves[0].move;
+        memcpy(context->pv_lines, lines, num_pv * sizeof(SearchResult));
+        context->num_pv_lines = num_pv;
+        context->best_line = lines[0];
+        context->depth_reached = depth;
+
+        sort_root_moves(root_moves, count, num_pv, game->is_white_turn);
 
-            current_move = current_move->next;
+        if (context->on_iteration != NULL)
+        {
+            context->on_iteration(context, context->user_data);
         }
 
-        // Execute the best move found
-        move(game, best_move->origin, best_move->target);
-        addMove(game->move_history, best_move->origin, best_move->target, '.', '.'); // add move to move history
+        // A forced mate won't change with more depth once the iteration was deep enough to see any shorter one
+        if (is_mate_score(context->best_line.score) && depth >= MATE_SCORE - abs(context->best_line.score))
+        {
+            break;
+        }
 
-        if (best_move->promotion_piece != '.')
+        // The next iteration takes several times longer than this one, don't start what can't finish
+        long long elapsed = current_time_ms() - context->start_time;
+        if (context->limits.move_time > 0 && elapsed * 2 >= context->limits.move_time)
         {
-            game->board.promotion_tile = best_move->target;
-            handle_promotion(&game->board, best_move->promotion_piece);
+            break;
         }
+    }
 
-        // Print the best move and statistics
-        char notation1[3], notation2[3];
-        double time_spent = (double)(clock() - start) / CLOCKS_PER_SEC;
-        position_to_notation(best_move->origin, notation1);
-        position_to_notation(best_move->target, notation2);
+    // The root score is exact, the aspiration window was widened until the score fell inside it
+    if (cacheable && context->depth_reached >= first_depth)
+    {
+        analysis_cache_store(context->cache, key, context->depth_reached, context->best_line.score, TT_EXACT, best_move);
+    }
+    return 1;
+}
 
-        // Calculate additional statistics
-        double positions_per_second = positions_counted / time_spent;
-        int depth_reached = SEARCH_DEPTH;
-        double branching_factor = pow(positions_counted, 1.0 / depth_reached);
+// A quiet move that caused a beta cutoff is tried early in the sibling nodes of the same ply
+static void store_killer(Move *killers, const Game *game, const Move *m)
+{
+    if (!is_quiet_move(game, m) || same_move(m, &killers[0]))
+    {
+        return;
+    }
+    killers[1] = killers[0];
+    killers[0] = *m;
+}
 
-        printf("\nEngine Move Analysis:\n");
-        printf("├─ Search depth:            %d\n", depth_reached + 1);
-        printf("├─ Best Move:               %s → %s %c\n", notation1, notation2, best_move->promotion_piece);
+// Searches captures and promotions until the position is quiet, so the static evaluation
+// isn't taken in the middle of an exchange. The side to move may stand pat on the evaluation
+// instead of capturing, except in check, where every evasion is searched.
+static int quiescence(Game *game, int ply, int alpha, int beta, SearchContext *context)
+{
+    context->positions_counted++;
+    if ((context->positions_counted & 1023) == 0)
+    {
+        check_search_limits(context);
+    }
+    if (context->stop)
+    {
+        return 0;
+    }
+
+    if (game->isCheck == 3 || game->isCheck == 4)
+        return mated_score(game->isCheck == 3, ply);
+    if (game->isCheck == 0)
+        return 0;
 
-        printf("├─ Positions analyzed:      %'lld\n", positions_counted);
-        printf("├─ Time spent:              %.3f seconds\n", time_spent);
-        printf("├─ Speed:                   %.0f positions/second\n", positions_per_second);
-        printf("└─ Avg. branching factor:   %.1f\n", branching_factor);
+    MovePicker picker;
+    int in_check = checkers(game) != 0;
+    int score = game->is_white_turn ? -1000000000 : 1000000000;
 
-        printf("\nBest line:\n");
-        for (int i = 0; i < best_result.length; i++)
+    if (in_check)
+    {
+        Move no_killers[2];
+        memset(no_killers, 0, sizeof(no_killers));
+        move_picker_init(&picker, game, NULL, no_killers);
+    }
+    else
+    {
+        score = evaluate_board(game);
+        if (game->is_white_turn ? score >= beta : score <= alpha)
         {
-            char from[3], to[3];
-            position_to_notation(best_result.moves[i].origin, from);
-            position_to_notation(best_result.moves[i].target, to);
-            printf("%d: %s → %s\n", i + 1, from, to);
+            return score;
         }
+        if (game->is_white_turn)
+            alpha = max(alpha, score);
+        else
+            beta = min(beta, score);
+        move_picker_init_quiescence(&picker, game);
     }
-    else
+
+    Move m;
+    int played = 0;
+    while (move_picker_next(&picker, &m))
+    {
+        played++;
+        Game temp_game;
+        memcpy(&temp_game, game, sizeof(Game));
+        play_move(&temp_game, m.origin, m.target, m.promotion_piece);
+
+        int child_score = quiescence(&temp_game, ply + 1, alpha, beta, context);
+        if (game->is_white_turn)
+        {
+            score = max(score, child_score);
+            alpha = max(alpha, score);
+        }
+        else
+        {
+            score = min(score, child_score);
+            beta = min(beta, score);
+        }
+        if (beta <= alpha)
+        {
+            break;
+        }
+    }
+
+    // In check without an evasion
+    if (in_check && played == 0)
+    {
+        return mated_score(game->is_white_turn, ply);
+    }
+    return score;
+}
+
+// At a frontier node (depth 1 or 2, not in check), whether a quiet move that doesn't give check
+// can be left out: if even the futility margin can't lift the static evaluation into the window,
+// or if the move loses material by static exchange
+static int prune_quiet_move(const Game *game, const Game *after, const Move *m, int depth, int static_eval,
+                            int alpha, int beta, SearchContext *context)
+{
+    if (after->isCheck != -1 || !is_quiet_move(game, m))
     {
         return 0;
     }
-    return 1;
+
+    int margin = context->params.futility_margin * depth;
+    int bound = game->is_white_turn ? alpha : beta;
+    int futile = game->is_white_turn ? static_eval + margin <= alpha : static_eval - margin >= beta;
+    if (margin > 0 && !is_mate_score(bound) && futile)
+    {
+        context->futility_pruned++;
+        return 1;
+    }
+    return see(&game->board, m) < -piece_values[PAWN] * depth;
 }
 
-SearchResult minimax(Game *game, int depth, int alpha, int beta, long long *positions_counted)
+// Whether the position at ply repeats an earlier one of the current line or of the game before
+// the root. Only positions since the last irreversible move can come back, with the same side to move.
+static int is_repetition(const Game *game, int ply, const SearchContext *context)
 {
-    SearchResult result = {0};
+    const KeyHistory *history = context->history;
+    for (int back = 4; back <= game->reversible_plies; back += 2)
+    {
+        int i = ply - back;
+        uint64_t earlier;
+        if (i >= 0)
+            earlier = context->keys[i];
+        else if (history != NULL && history->count + i >= 0)
+            earlier = history->keys[history->count + i];
+        else
+            break;
+
+        if (earlier == context->keys[ply])
+            return 1;
+    }
+    return 0;
+}
+
+SearchResult minimax(Game *game, int depth, int ply, int alpha, int beta, SearchContext *context)
+{
+    SearchResult result;
+    result.score = 0;
     result.length = 0;
 
+    // A repetition, or a position the fifty-move rule has drawn, is a draw whatever is played next.
+    // A checkmate comes before the fifty-move rule.
+    uint64_t key = position_key(game);
+    context->keys[ply] = key;
+    if (is_repetition(game, ply, context) || (game->halfmove_clock >= 100 && (checkers(game) == 0 || has_legal_move(game))))
+    {
+        return result;
+    }
+
+    // At the horizon only captures are searched on, the quiescence search scores the position
+    if (depth == 0)
+    {
+        result.score = quiescence(game, ply, alpha, beta, context);
+        return result;
+    }
+
+    // Limits are checked every 1024 positions, the clock is too slow to read at every node
+    context->positions_counted++;
+    if ((context->positions_counted & 1023) == 0)
+    {
+        check_search_limits(context);
+    }
+    if (context->stop)
+    {
+        return result;
+    }
+
     // Base cases
-    if (depth == 0 || game->possible_moves->size == 0 || game->isCheck == 3 || game->isCheck == 4 || game->isCheck == 0)
-    {
-        (*positions_counted)++;
-        if (game->isCheck == 3)
-            result.score = -999999;
-        else if (game->isCheck == 4)
-            result.score = 999999;
-        else if (game->isCheck == 0)
-            result.score = 0;
-        else
-            result.score = evaluate_board(game);
+    if (game->isCheck == 3 || game->isCheck == 4 || game->isCheck == 0)
+    {
+        result.score = game->isCheck == 0 ? 0 : mated_score(game->isCheck == 3, ply);
+        return result;
+    }
+
+    // Mate distance pruning: the side to move can't do better than mating with its next move, nor
+    // worse than being mated right here. When a shorter mate is already known the window closes.
+    int mate_now = mated_score(game->is_white_turn, ply);
+    int mate_next = mated_score(!game->is_white_turn, ply + 1);
+    int lowest = game->is_white_turn ? mate_now : mate_next;
+    int highest = game->is_white_turn ? mate_next : mate_now;
+    if (lowest >= beta || highest <= alpha)
+    {
+        result.score = lowest >= beta ? lowest : highest;
         return result;
     }
+    alpha = max(alpha, lowest);
+    beta = min(beta, highest);
+
+    // A bitbase draw is final. A bitbase win only narrows the window to the win scores and the
+    // mates, the search goes on so that an actual mate still beats the heuristic score.
+    int bitbase_result;
+    if (bitbase_probe(game->bitbases, game, &bitbase_result))
+    {
+        if (bitbase_result == 0)
+        {
+            return result;
+        }
+        int lower = bitbase_result > 0 ? BITBASE_WIN_SCORE : -MATE_SCORE;
+        int upper = bitbase_result > 0 ? MATE_SCORE : -BITBASE_WIN_SCORE;
+        if (lower >= beta || upper <= alpha)
+        {
+            result.score = lower >= beta ? lower : upper;
+            return result;
+        }
+        alpha = max(alpha, lower);
+        beta = min(beta, upper);
+    }
+
+    // An earlier search of this position may already decide it, or at least tell which move to try first
+    const TTEntry *entry = NULL;
+    if (context->tt != NULL)
+    {
+        entry = tt_probe(context->tt, key);
+        int tt_score = entry != NULL ? score_from_tt(entry->score, ply) : 0;
+        if (entry != NULL && entry->depth >= depth &&
+            (entry->bound == TT_EXACT ||
+             (entry->bound == TT_LOWER && tt_score >= beta) ||
+             (entry->bound == TT_UPPER && tt_score <= alpha)))
+        {
+            result.score = tt_score;
+            return result;
+        }
+    }
+    int original_alpha = alpha;
+    int original_beta = beta;
+
+    // Frontier nodes are pruned by their static evaluation
+    int frontier = depth <= 2 && checkers(game) == 0;
+    int static_eval = frontier ? evaluate_board(game) : 0;
+
+    // Razoring: this far below the window only a capture could help, so the quiescence search decides
+    int razor_margin = context->params.razor_margin * depth;
+    if (frontier && razor_margin > 0 && !is_mate_score(game->is_white_turn ? alpha : beta) &&
+        (game->is_white_turn ? static_eval + razor_margin <= alpha : static_eval - razor_margin >= beta))
+    {
+        int score = quiescence(game, ply, alpha, beta, context);
+        if (game->is_white_turn ? score <= alpha : score >= beta)
+        {
+            context->razored++;
+            result.score = score;
+            return result;
+        }
+    }
+
+    // Moves come one at a time, the later stages are only generated if nothing cut off yet
+    MovePicker picker;
+    Move *killers = context->killers[min(ply, MAX_SEARCH_DEPTH - 1)];
+    move_picker_init(&picker, game, entry, killers);
+    Move m;
+    int played = 0;
 
     if (game->is_white_turn)
     {
         result.score = -1000000000;
-        game->possible_moves = calculate_all_moves(game, 1);
-        Move *current_move = game->possible_moves->head;
 
-        while (current_move != NULL)
+        while (move_picker_next(&picker, &m))
         {
             Game temp_game;
             memcpy(&temp_game, game, sizeof(Game));
+            play_move(&temp_game, m.origin, m.target, m.promotion_piece);
 
-            // Handle different move types (normal, promotion, castling)
-            if (current_move->promotion_piece != '.')
-            {
-                move(&temp_game, current_move->origin, current_move->target);
-                temp_game.board.promotion_tile = current_move->target;
-                handle_promotion(&temp_game.board, current_move->promotion_piece);
-            }
-            else if (handle_castling(&temp_game, get_piece_at_position(&game->board, current_move->origin), current_move->origin, current_move->target))
+            // one move is always searched, so mates are still seen
+            if (frontier && played > 0 && prune_quiet_move(game, &temp_game, &m, depth, static_eval, alpha, beta, context))
             {
-                move(&temp_game, current_move->origin, current_move->target);
+                continue;
             }
-            else
-            {
-                move(&temp_game, current_move->origin, current_move->target);
-            }
-
-            toggle_turn(&temp_game);
+            played++;
 
-            // Update game state and get evaluation
-            check_check(&temp_game);
-            check_checkmate(&temp_game);
-
-            SearchResult child_result = minimax(&temp_game, depth - 1, alpha, beta, positions_counted);
+            int extension = check_extension(&temp_game, depth - 1, ply + 1, context);
+            SearchResult child_result = minimax(&temp_game, depth - 1 + extension, ply + 1, alpha, beta, context);
 
             if (child_result.score > result.score)
             {
                 result.score = child_result.score;
-
-                // Ensure we don't exceed array bounds
-                if (child_result.length + 1 >= 4096)
-                {
-                    result.length = 4095;
-                    printf("Error: Move array overflow. Truncating to 4095 moves.\n");
-                }
-                else
-                {
-                    // Copy current move but clear the pointers
-                    result.moves[0] = *current_move;
-                    result.moves[0].next = NULL;
-                    result.moves[0].prev = NULL;
-
-                    // Copy the child's moves
-                    memcpy(&result.moves[1], child_result.moves, child_result.length * sizeof(Move));
-                    result.length = child_result.length + 1;
-                }
+                store_line(&result, &m, &child_result);
             }
 
             alpha = alpha > result.score ? alpha : result.score;
             if (beta <= alpha)
+            {
+                store_killer(killers, game, &m);
                 break;
-
-            current_move = current_move->next;
+            }
         }
-        return result;
     }
     else
     {
         result.score = 1000000000;
-        game->possible_moves = calculate_all_moves(game, 0);
-        Move *current_move = game->possible_moves->head;
 
-        while (current_move != NULL)
+        while (move_picker_next(&picker, &m))
         {
             Game temp_game;
             memcpy(&temp_game, game, sizeof(Game));
+            play_move(&temp_game, m.origin, m.target, m.promotion_piece);
 
-            // Handle different move types (normal, promotion, castling)
-            if (current_move->promotion_piece != '.')
+            if (frontier && played > 0 && prune_quiet_move(game, &temp_game, &m, depth, static_eval, alpha, beta, context))
             {
-                move(&temp_game, current_move->origin, current_move->target);
-                temp_game.board.promotion_tile = current_move->target;
-                handle_promotion(&temp_game.board, current_move->promotion_piece);
-            }
-            else if (handle_castling(&temp_game, get_piece_at_position(&game->board, current_move->origin), current_move->origin, current_move->target))
-            {
-                move(&temp_game, current_move->origin, current_move->target);
-            }
-            else
-            {
-                move(&temp_game, current_move->origin, current_move->target);
+                continue;
             }
+            played++;
 
-            toggle_turn(&temp_game);
-
-            // Update game state and get evaluation
-            check_check(&temp_game);
-            check_checkmate(&temp_game);
-
-            SearchResult child_result = minimax(&temp_game, depth - 1, alpha, beta, positions_counted);
+            int extension = check_extension(&temp_game, depth - 1, ply + 1, context);
+            SearchResult child_result = minimax(&temp_game, depth - 1 + extension, ply + 1, alpha, beta, context);
 
             if (child_result.score < result.score)
             {
                 result.score = child_result.score;
-
-                // Ensure we don't exceed array bounds
-                if (child_result.length + 1 >= 4096)
-                {
-                    result.length = 4095;
-                    printf("Error: Move array overflow. Truncating to 4095 moves.\n");
-                }
-                else
-                {
-                    // Copy current move but clear the pointers
-                    result.moves[0] = *current_move;
-                    result.moves[0].next = NULL;
-                    result.moves[0].prev = NULL;
-
-                    // Copy the child's moves
-                    memcpy(&result.moves[1], child_result.moves, child_result.length * sizeof(Move));
-                    result.length = child_result.length + 1;
-                }
+                store_line(&result, &m, &child_result);
             }
 
             beta = beta < result.score ? beta : result.score;
             if (beta <= alpha)
+            {
+                store_killer(killers, game, &m);
                 break;
-
-            current_move = current_move->next;
+            }
         }
+    }
+
+    // No legal move: checkmate or stalemate
+    if (played == 0)
+    {
+        result.score = checkers(game) == 0 ? 0 : mated_score(game->is_white_turn, ply);
         return result;
     }
+
+    // The score is exact only if it fell inside the window this node was searched with
+    if (!context->stop)
+    {
+        int bound = result.score <= original_alpha ? TT_UPPER : result.score >= original_beta ? TT_LOWER : TT_EXACT;
+        tt_store(context->tt, key, depth, score_to_tt(result.score, ply), bound, result.length > 0 ? &result.moves[0] : NULL);
+    }
+    return result;
 }
 
 int evaluate_board(Game *game)
@@ -270,88 +733,45 @@ int evaluate_board(Game *game)
     if (game->isCheck == 0)
         return 0; // stalemate
 
+    int bitbase_result;
+    if (bitbase_probe(game->bitbases, game, &bitbase_result))
+        return bitbase_result == 0 ? 0 : bitbase_win_score(game, bitbase_result);
+
     int white_score = 0;
     int black_score = 0;
 
     // Material and position evaluation (existing code)
-    Bitboard black_pieces = game->board.black_pieces;
-    Bitboard white_pieces = game->board.white_pieces;
+    Bitboard black_pieces = game->board.occupied[BLACK];
+    Bitboard white_pieces = game->board.occupied[WHITE];
 
     while (black_pieces)
     {
         int pos = get_and_clear_LSB(&black_pieces);
-        black_score += piece_value(get_piece_at_position(&game->board, pos), pos);
+        black_score += piece_value(game->board.squares[pos], pos);
     }
 
     while (white_pieces)
     {
         int pos = get_and_clear_LSB(&white_pieces);
-        white_score += piece_value(get_piece_at_position(&game->board, pos), pos);
+        white_score += piece_value(game->board.squares[pos], pos);
     }
 
     score = white_score - black_score;
     return score;
 }
 
-int piece_value(char piece, int position)
+// Material and square table values by piece type
+const int piece_values[6] = {PAWN_VALUE, KNIGHT_VALUE, BISHOP_VALUE, ROOK_VALUE, QUEEN_VALUE, KING_VALUE};
+static const int *const PIECE_SQUARE_TABLES[6] = {PAWN_SQUARE_TABLE, KNIGHT_SQUARE_TABLE, BISHOP_SQUARE_TABLE,
+                                                  ROOK_SQUARE_TABLE, QUEEN_SQUARE_TABLE, KING_SQUARE_TABLE};
+
+// Value of a piece code on a square; the tables are written for white, black reads them mirrored
+int piece_value(int piece, int position)
 {
-    int base_value;
-    int position_value;
-    int mirror_position = 63 - position;
-
-    // Get base piece value
-    switch (piece)
-    {
-    case 'P':
-        base_value = PAWN_VALUE;
-        position_value = PAWN_SQUARE_TABLE[position];
-        break;
-    case 'N':
-        base_value = KNIGHT_VALUE;
-        position_value = KNIGHT_SQUARE_TABLE[position];
-        break;
-    case 'B':
-        base_value = BISHOP_VALUE;
-        position_value = BISHOP_SQUARE_TABLE[position];
-        break;
-    case 'R':
-        base_value = ROOK_VALUE;
-        position_value = ROOK_SQUARE_TABLE[position];
-        break;
-    case 'Q':
-        base_value = QUEEN_VALUE;
-        position_value = QUEEN_SQUARE_TABLE[position];
-        break;
-    case 'K':
-        base_value = KING_VALUE;
-        position_value = KING_SQUARE_TABLE[position];
-        break;
-    case 'p':
-        base_value = PAWN_VALUE;
-        position_value = PAWN_SQUARE_TABLE[mirror_position];
-        break;
-    case 'n':
-        base_value = KNIGHT_VALUE;
-        position_value = KNIGHT_SQUARE_TABLE[mirror_position];
-        break;
-    case 'b':
-        base_value = BISHOP_VALUE;
-        position_value = BISHOP_SQUARE_TABLE[mirror_position];
-        break;
-    case 'r':
-        base_value = ROOK_VALUE;
-        position_value = ROOK_SQUARE_TABLE[mirror_position];
-        break;
-    case 'q':
-        base_value = QUEEN_VALUE;
-        position_value = QUEEN_SQUARE_TABLE[mirror_position];
-        break;
-    case 'k':
-        base_value = KING_VALUE;
-        position_value = KING_SQUARE_TABLE[mirror_position];
-        break;
-    default:
+    if (piece == EMPTY)
         return 0;
-    }
-    return base_value + position_value;
+
+    int type = PIECE_TYPE(piece);
+    int square = PIECE_COLOR(piece) == WHITE ? position : 63 - position;
+    return piece_values[type] + PIECE_SQUARE_TABLES[type][square];
 }
\ No newline at end of file
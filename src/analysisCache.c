@@ -0,0 +1,220 @@
+#include "chessEngine.h"
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Persistent analysis cache: a fixed-size hash file of root search results, shared
+// through a MAP_SHARED mapping by every process that opens it. There are no locks on the
+// entries. Each entry is two 64-bit words, (key ^ data, data), written with single atomic
+// stores; a reader that sees half of a concurrent write gets a key mismatch and treats it
+// as a miss, so readers and writers in any number of processes can't see torn results.
+
+#define CACHE_MAGIC "PCAC"
+#define CACHE_VERSION 4 // 2: mate scores count the plies to the mate, 3: Polyglot position keys, 4: fifty-move clock in the key
+#define CACHE_HEADER_SIZE 64 // keeps the buckets aligned to cache lines
+#define CACHE_BUCKET_SIZE 4  // entries per bucket, 64 bytes
+
+typedef struct
+{
+    char magic[4];
+    uint32_t version;
+    uint64_t num_buckets;
+} CacheHeader;
+
+// data word: score (32 bits), depth (8), bound (8), move (16)
+static uint64_t pack_entry(int depth, int score, int bound, uint16_t move)
+{
+    return (uint64_t)(uint32_t)score | (uint64_t)(uint8_t)depth << 32 | (uint64_t)(uint8_t)bound << 40 | (uint64_t)move << 48;
+}
+
+// Builds a new empty cache of about size_mb megabytes next to path and renames it over
+// path, so processes that still map the old file keep their own copy. Returns the new
+// file's descriptor, -1 on error.
+static int create_cache_file(const char *path, size_t size_mb, CacheHeader *header)
+{
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, CACHE_MAGIC, 4);
+    header->version = CACHE_VERSION;
+    header->num_buckets = 1;
+    while (header->num_buckets * 2 * CACHE_BUCKET_SIZE * 16 <= size_mb * 1024 * 1024)
+        header->num_buckets *= 2;
+
+    char temp_path[512];
+    snprintf(temp_path, sizeof(temp_path), "%s.XXXXXX", path);
+    int fd = mkstemp(temp_path);
+    if (fd < 0)
+        return -1;
+
+    // ftruncate fills the entries with zeros, which are empty slots
+    if (fchmod(fd, 0644) < 0 || ftruncate(fd, CACHE_HEADER_SIZE + header->num_buckets * CACHE_BUCKET_SIZE * 16) < 0 ||
+        pwrite(fd, header, sizeof(*header), 0) != sizeof(*header) || rename(temp_path, path) < 0)
+    {
+        unlink(temp_path);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Opens the cache file, creating it with about size_mb megabytes if it doesn't exist.
+// An existing file keeps the size it was created with.
+AnalysisCache *analysis_cache_open(const char *path, size_t size_mb)
+{
+    CacheHeader header;
+    int fd;
+    while (1)
+    {
+        fd = open(path, O_RDWR | O_CREAT, 0644);
+        if (fd < 0)
+        {
+            printf("ERROR: unable to open analysis cache %s\n", path);
+            return NULL;
+        }
+
+        // Only one process sets up a new file
+        flock(fd, LOCK_EX);
+        struct stat st, current;
+        if (fstat(fd, &st) < 0)
+        {
+            printf("ERROR: unable to stat analysis cache %s\n", path);
+            flock(fd, LOCK_UN);
+            close(fd);
+            return NULL;
+        }
+
+        // Another process replaced the file while we waited for the lock
+        if (stat(path, &current) < 0 || current.st_ino != st.st_ino || current.st_dev != st.st_dev)
+        {
+            flock(fd, LOCK_UN);
+            close(fd);
+            continue;
+        }
+
+        if (st.st_size >= CACHE_HEADER_SIZE && pread(fd, &header, sizeof(header), 0) == sizeof(header) &&
+            memcmp(header.magic, CACHE_MAGIC, 4) == 0 && header.version == CACHE_VERSION &&
+            header.num_buckets > 0 && (header.num_buckets & (header.num_buckets - 1)) == 0 &&
+            header.num_buckets <= (uint64_t)st.st_size / (CACHE_BUCKET_SIZE * 16) &&
+            (uint64_t)st.st_size == CACHE_HEADER_SIZE + header.num_buckets * CACHE_BUCKET_SIZE * 16)
+        {
+            flock(fd, LOCK_UN);
+            break;
+        }
+
+        if (st.st_size > 0)
+            printf("Analysis cache %s has an unknown format or size, starting a new one\n", path);
+
+        int new_fd = create_cache_file(path, size_mb, &header);
+        flock(fd, LOCK_UN);
+        close(fd);
+        if (new_fd < 0)
+        {
+            printf("ERROR: unable to create analysis cache %s\n", path);
+            return NULL;
+        }
+        fd = new_fd;
+        break;
+    }
+
+    size_t mapping_size = CACHE_HEADER_SIZE + header.num_buckets * CACHE_BUCKET_SIZE * 16;
+    void *mapping = mmap(NULL, mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED)
+    {
+        printf("ERROR: unable to map analysis cache %s\n", path);
+        close(fd);
+        return NULL;
+    }
+    madvise(mapping, mapping_size, MADV_RANDOM);
+
+    AnalysisCache *cache = (AnalysisCache *)malloc(sizeof(AnalysisCache));
+    if (cache == NULL)
+    {
+        printf("ERROR: Failed to create analysis cache\n");
+        munmap(mapping, mapping_size);
+        close(fd);
+        return NULL;
+    }
+    cache->fd = fd;
+    cache->mapping = mapping;
+    cache->mapping_size = mapping_size;
+    cache->entries = (uint64_t *)((char *)mapping + CACHE_HEADER_SIZE);
+    cache->num_buckets = header.num_buckets;
+    cache->min_depth = DEFAULT_CACHE_DEPTH;
+    return cache;
+}
+
+void analysis_cache_close(AnalysisCache *cache)
+{
+    if (cache == NULL)
+        return;
+
+    munmap(cache->mapping, cache->mapping_size);
+    close(cache->fd);
+    free(cache);
+}
+
+// Looks the key up; returns 1 and fills out (key, score, depth, bound, move) on a hit
+int analysis_cache_probe(const AnalysisCache *cache, uint64_t key, TTEntry *out)
+{
+    if (cache == NULL)
+        return 0;
+
+    uint64_t *bucket = cache->entries + (key & (cache->num_buckets - 1)) * CACHE_BUCKET_SIZE * 2;
+    for (int i = 0; i < CACHE_BUCKET_SIZE; i++)
+    {
+        uint64_t check = __atomic_load_n(&bucket[i * 2], __ATOMIC_RELAXED);
+        uint64_t data = __atomic_load_n(&bucket[i * 2 + 1], __ATOMIC_RELAXED);
+        if (data == 0 || (check ^ data) != key)
+            continue;
+
+        out->key = key;
+        out->score = (int32_t)(uint32_t)data;
+        out->depth = (int8_t)(data >> 32);
+        out->bound = (uint8_t)(data >> 40);
+        out->move = (uint16_t)(data >> 48);
+        return 1;
+    }
+    return 0;
+}
+
+// Stores a result. The key's own slot is only overwritten by a search at least as deep;
+// otherwise an empty slot is used, or else the shallowest entry in the bucket is replaced.
+void analysis_cache_store(AnalysisCache *cache, uint64_t key, int depth, int score, int bound, const Move *best_move)
+{
+    if (cache == NULL || depth < cache->min_depth)
+        return;
+
+    uint64_t *bucket = cache->entries + (key & (cache->num_buckets - 1)) * CACHE_BUCKET_SIZE * 2;
+    int slot = -1;
+    int shallowest = 0;
+    int shallowest_depth = 1000;
+
+    for (int i = 0; i < CACHE_BUCKET_SIZE; i++)
+    {
+        uint64_t check = __atomic_load_n(&bucket[i * 2], __ATOMIC_RELAXED);
+        uint64_t data = __atomic_load_n(&bucket[i * 2 + 1], __ATOMIC_RELAXED);
+        int entry_depth = (int8_t)(data >> 32);
+
+        if (data != 0 && (check ^ data) == key)
+        {
+            if (entry_depth > depth)
+                return;
+            slot = i;
+            break;
+        }
+        if (data == 0 && slot < 0)
+            slot = i;
+        if (entry_depth < shallowest_depth)
+        {
+            shallowest = i;
+            shallowest_depth = entry_depth;
+        }
+    }
+    if (slot < 0)
+        slot = shallowest;
+
+    uint64_t data = pack_entry(depth, score, bound, tt_encode_move(best_move));
+    __atomic_store_n(&bucket[slot * 2], key ^ data, __ATOMIC_RELAXED);
+    __atomic_store_n(&bucket[slot * 2 + 1], data, __ATOMIC_RELAXED);
+}
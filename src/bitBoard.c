@@ -1,7 +1,4 @@
-#include "a_header.h"
-
-// Define the global variables
-ChessBoard global_board;
+#include "chessEngine.h"
 
 // Example usage
 int initialize_board(Game *game)
@@ -12,371 +9,169 @@ int initialize_board(Game *game)
         return 0;
     }
 
-    if (game->human_color == 1) // 1 for white, 0 for black
-    {
-        // Set starting bits for white pieces
-        game->board.white_pawns = 0x00FF000000000000;
-        game->board.white_knights = 0x4200000000000000;
-        game->board.white_bishops = 0x2400000000000000;
-        game->board.white_rooks = 0x8100000000000000;
-        game->board.white_queens = 0x0800000000000000;
-        game->board.white_king = 0x1000000000000000;
-
-        // Set starting bits for black pieces
-        game->board.black_pawns = 0xff00;
-        game->board.black_bishops = 0x0024;
-        game->board.black_knights = 0x0042;
-        game->board.black_rooks = 0x0081;
-        game->board.black_queens = 0x0008;
-        game->board.black_king = 0x0010;
-    }
-    else if (game->human_color == 0)
-    {
-        // Set starting bits for black pieces (mirrored)
-        game->board.white_pawns = 0xff00;
-        game->board.white_bishops = 0x0024;
-        game->board.white_knights = 0x0042;
-        game->board.white_rooks = 0x0081;
-        game->board.white_queens = 0x0010;
-        game->board.white_king = 0x0008;
-
-        // Set starting bits for white pieces
-        game->board.black_pawns = 0x00FF000000000000;
-        game->board.black_knights = 0x4200000000000000;
-        game->board.black_bishops = 0x2400000000000000;
-        game->board.black_rooks = 0x8100000000000000;
-        game->board.black_queens = 0x1000000000000000;
-        game->board.black_king = 0x0800000000000000;
-    }
+    ChessBoard *board = &game->board;
+    memset(board, 0, sizeof(ChessBoard));
 
-    // Initialize castling flags
-    game->board.white_king_moved = 0;
-    game->board.black_king_moved = 0;
-    game->board.rook_on0_moved = 0;
-    game->board.rook_on7_moved = 0;
-    game->board.rook_on56_moved = 0;
-    game->board.rook_on63_moved = 0;
+    // Square 0 is a8 and square 63 is h1: white starts on squares 48-63, black on 0-15
+    board->pieces[WHITE][PAWN] = 0x00FF000000000000;
+    board->pieces[WHITE][KNIGHT] = 0x4200000000000000;
+    board->pieces[WHITE][BISHOP] = 0x2400000000000000;
+    board->pieces[WHITE][ROOK] = 0x8100000000000000;
+    board->pieces[WHITE][QUEEN] = 0x0800000000000000;
+    board->pieces[WHITE][KING] = 0x1000000000000000;
+    board->pieces[BLACK][PAWN] = 0xff00;
+    board->pieces[BLACK][KNIGHT] = 0x0042;
+    board->pieces[BLACK][BISHOP] = 0x0024;
+    board->pieces[BLACK][ROOK] = 0x0081;
+    board->pieces[BLACK][QUEEN] = 0x0008;
+    board->pieces[BLACK][KING] = 0x0010;
 
-    game->isCheck = -1;
-    if (game->human_color == 1)
-    {
-        game->white_king = 60;
-        game->black_king = 4;
-    }
-    else
+    memset(board->squares, EMPTY, sizeof(board->squares));
+    for (int piece = 0; piece < EMPTY; piece++)
     {
-        game->white_king = 3;
-        game->black_king = 59;
+        Bitboard bb = board->pieces[PIECE_COLOR(piece)][PIECE_TYPE(piece)];
+        board->occupied[PIECE_COLOR(piece)] |= bb;
+        while (bb)
+            board->squares[get_and_clear_LSB(&bb)] = piece;
     }
-    // global_board.is_game_over = 0;
 
-    update_threat_map(game);
+    board->castling = CASTLE_WHITE_SHORT | CASTLE_WHITE_LONG | CASTLE_BLACK_SHORT | CASTLE_BLACK_LONG;
+    board->en_passant = -1;
+
+    game->is_white_turn = 1;
+    game->isCheck = -1;
+    game->ply = 0;
+    game->halfmove_clock = 0;
+    game->reversible_plies = 0;
     return 3;
 }
 
-void calcReachablePositions(Game *game)
+// The piece on a square as a letter ('P', 'n', ...), '.' if the square is empty
+char get_piece_at_position(const ChessBoard *board, int position)
 {
-    int start_position = game->selected_position;
-
-    game->board.reachable_positions = 0;
-
-    if (game->possible_moves == NULL)
-    {
-        printf("Error: possible_moves is NULL\n");
-        return;
-    }
+    return "pnbrqkPNBRQK."[board->squares[position]];
+}
 
-    if (game->possible_moves->head == NULL)
-    {
-        printf("Error: possible_moves->head is NULL\n");
-        return;
-    }
+// Piece code of a letter ('P', 'n', ...), EMPTY for anything else
+int piece_code(char piece)
+{
+    const char *name = strchr("pnbrqkPNBRQK", piece);
+    return piece == '\0' || name == NULL ? EMPTY : (int)(name - "pnbrqkPNBRQK");
+}
 
-    Move *current_move = game->possible_moves->head;
-    while (current_move != NULL)
-    {
-        if (current_move->origin == start_position)
-        {
-            game->board.reachable_positions |= position_to_Bitboard(current_move->target);
-        }
-        current_move = current_move->next;
-    }
+// The bitboard holding the given piece ('P', 'n', ...), NULL for anything else
+Bitboard *piece_bitboard(ChessBoard *board, char piece)
+{
+    int code = piece_code(piece);
+    return code == EMPTY ? NULL : &board->pieces[PIECE_COLOR(code)][PIECE_TYPE(code)];
 }
 
-char get_piece_at_position(const ChessBoard *board, int position)
+// Puts a piece on an empty square
+void place_piece(ChessBoard *board, int piece, int position)
 {
-    Bitboard mask = 1ULL << position;
+    Bitboard bb = position_to_Bitboard(position);
+    board->pieces[PIECE_COLOR(piece)][PIECE_TYPE(piece)] |= bb;
+    board->occupied[PIECE_COLOR(piece)] |= bb;
+    board->squares[position] = piece;
+}
 
-    // Quick check if square is empty
-    if (!(mask & (board->white_pieces | board->black_pieces)))
-        return '.';
+// Squares attacked by a set of pawns: two shifts, the file masks stop wrapping around the board
+Bitboard pawn_attacks(Bitboard pawns, int color)
+{
+    if (color == WHITE)
+        return ((pawns & ~FILE_A) >> 9) | ((pawns & ~FILE_H) >> 7);
+    return ((pawns & ~FILE_A) << 7) | ((pawns & ~FILE_H) << 9);
+}
 
-    // Check white pieces
-    if (mask & board->white_pieces)
-    {
-        if (mask & board->white_pawns)
-            return 'P';
-        if (mask & board->white_knights)
-            return 'N';
-        if (mask & board->white_bishops)
-            return 'B';
-        if (mask & board->white_rooks)
-            return 'R';
-        if (mask & board->white_queens)
-            return 'Q';
-        return 'K'; // Must be king if it's a white piece
-    }
+// Squares a set of pawns reaches with a single step onto an empty square
+Bitboard pawn_pushes(Bitboard pawns, int color, Bitboard empty)
+{
+    return (color == WHITE ? pawns >> 8 : pawns << 8) & empty;
+}
 
-    // Check black pieces
-    if (mask & board->black_pawns)
-        return 'p';
-    if (mask & board->black_knights)
-        return 'n';
-    if (mask & board->black_bishops)
-        return 'b';
-    if (mask & board->black_rooks)
-        return 'r';
-    if (mask & board->black_queens)
-        return 'q';
-    return 'k'; // Must be king if it's a black piece
+// Squares reached with a double step from the starting rank, both squares being empty
+Bitboard pawn_double_pushes(Bitboard pawns, int color, Bitboard empty)
+{
+    Bitboard start_rank = color == WHITE ? RANK_2 : RANK_7;
+    return pawn_pushes(pawn_pushes(pawns & start_rank, color, empty), color, empty);
 }
 
+// Targets of a single pawn of the side to move; the move generator handles all pawns at once
 Bitboard calculate_pawn_moves(Game *game, int start_position, int attacksOnly)
 {
-    // These determine how pawns move based on player color and board orientation
-    int board_direction = (game->human_color == 1) ? -1 : 1;   // Direction from player's perspective
-    int piece_direction = (game->is_white_turn == 1) ? 1 : -1; // Direction pieces should move
-    int pawn_step = board_direction * piece_direction;         // Final movement direction for pawns
-
-    Bitboard friendly_pieces = (game->is_white_turn == 1) ? game->board.white_pieces : game->board.black_pieces;
-    Bitboard hostile_pieces = (game->is_white_turn == 1) ? game->board.black_pieces : game->board.white_pieces;
-
-    Bitboard pawn_moves = 0;
-
-    // Move forward
-    int step1 = start_position + (8 * pawn_step);     // move one step forward
-    int step2 = start_position + (2 * 8 * pawn_step); // move two steps forward
-
-    // Check single step forward
-    if (attacksOnly == 0)
+    int color = game->is_white_turn;
+    Bitboard pawn = position_to_Bitboard(start_position);
+    Bitboard attacks = pawn_attack_table[color][start_position];
+    if (attacksOnly)
     {
-        if (step1 >= 0 && step1 < 64)
-        {
-            // Only allow move if square is empty (no friendly or hostile pieces)
-            if (get_piece_at_position(&game->board, step1) == '.')
-            {
-                pawn_moves |= position_to_Bitboard(step1);
-
-                // Only check double step if single step is possible
-                if (step2 >= 0 && step2 < 64)
-                {
-                    // Check if pawn is on starting rank
-                    if (game->is_white_turn)
-                    {
-                        // White pawns' starting rank
-                        if ((game->human_color == 0 && 8 <= start_position && start_position <= 15) ||
-                            (game->human_color == 1 && 48 <= start_position && start_position <= 55))
-                        {
-                            // Check if second square is also empty
-                            if (get_piece_at_position(&game->board, step2) == '.')
-                            {
-                                pawn_moves |= position_to_Bitboard(step2);
-                            }
-                        }
-                    }
-                    else
-                    {
-                        // Black pawns' starting rank
-                        if ((game->human_color == 0 && 48 <= start_position && start_position <= 55) ||
-                            (game->human_color == 1 && 8 <= start_position && start_position <= 15))
-                        {
-                            // Check if second square is also empty
-                            if (get_piece_at_position(&game->board, step2) == '.')
-                            {
-                                pawn_moves |= position_to_Bitboard(step2);
-                            }
-                        }
-                    }
-                }
-            }
-        }
+        return attacks;
     }
 
-    // Calculate diagonal captures/threats
-    int topLeft = start_position + (7 * pawn_step);
-    int topRight = start_position + (9 * pawn_step);
-
-    // Check if positions are within bounds
-    if (topLeft >= 0 && topLeft < 64 && abs((topLeft % 8) - (start_position % 8)) == 1)
+    Bitboard empty = ~(game->board.occupied[WHITE] | game->board.occupied[BLACK]);
+    Bitboard capturable = game->board.occupied[!color];
+    if (game->board.en_passant >= 0)
     {
-        if (attacksOnly)
-        {
-            // For threat map, add diagonal regardless of piece presence
-            pawn_moves |= position_to_Bitboard(topLeft);
-        }
-        else if (position_to_Bitboard(topLeft) & hostile_pieces)
-        {
-            // For actual moves, only add if enemy piece present
-            pawn_moves |= position_to_Bitboard(topLeft);
-        }
+        capturable |= position_to_Bitboard(game->board.en_passant);
     }
+    return pawn_pushes(pawn, color, empty) | pawn_double_pushes(pawn, color, empty) | (attacks & capturable);
+}
 
-    if (topRight >= 0 && topRight < 64 && abs((topRight % 8) - (start_position % 8)) == 1)
+// Squares reached from square by walking each of the directions (a shift and the mask that stops
+// it at the board edge) until the first occupied square, which is included
+static Bitboard ray_attacks(int square, Bitboard occupied, const int shifts[4], const Bitboard edges[4])
+{
+    Bitboard attacks = 0;
+    for (int d = 0; d < 4; d++)
     {
-        if (attacksOnly)
-        {
-            // For threat map, add diagonal regardless of piece presence
-            pawn_moves |= position_to_Bitboard(topRight);
-        }
-        else if (position_to_Bitboard(topRight) & hostile_pieces)
+        Bitboard ray = position_to_Bitboard(square);
+        while (ray & edges[d])
         {
-            // For actual moves, only add if enemy piece present
-            pawn_moves |= position_to_Bitboard(topRight);
+            ray = shifts[d] > 0 ? ray << shifts[d] : ray >> -shifts[d];
+            attacks |= ray;
+            if (ray & occupied)
+                break; // Stop after hitting any piece
         }
     }
+    return attacks;
+}
 
-    // en passant
-    if (game->board.last_move_double_pawn_push == 1)
-    {
-        int file_diff = abs((game->board.last_move_double_pawn_push_tile % 8) - (start_position % 8));
-        int rank_diff = abs((game->board.last_move_double_pawn_push_tile / 8) - (start_position / 8));
-
-        // Check if our pawn is adjacent to the double-pushed pawn
-        if (file_diff == 1 && rank_diff == 0)
-        {
-            // Calculate the en passant capture square
-            int capture_square = game->board.last_move_double_pawn_push_tile + (8 * pawn_step);
-
-            // Add the en passant move
-            if (capture_square >= 0 && capture_square < 64)
-            {
-                pawn_moves |= position_to_Bitboard(capture_square);
-            }
-        }
-    }
+// Rook attacks from one square: west, east, north, south
+Bitboard rook_attacks(int square, Bitboard occupied)
+{
+    static const int shifts[4] = {-1, 1, -8, 8};
+    static const Bitboard edges[4] = {~FILE_A, ~FILE_H, ~RANK_8, ~RANK_1};
+    return ray_attacks(square, occupied, shifts, edges);
+}
 
-    return pawn_moves;
+// Bishop attacks from one square: south-west, south-east, north-west, north-east
+Bitboard bishop_attacks(int square, Bitboard occupied)
+{
+    static const int shifts[4] = {7, 9, -9, -7};
+    static const Bitboard edges[4] = {~FILE_A & ~RANK_1, ~FILE_H & ~RANK_1, ~FILE_A & ~RANK_8, ~FILE_H & ~RANK_8};
+    return ray_attacks(square, occupied, shifts, edges);
 }
 
 Bitboard calculate_rook_moves(Game *game, int start_position, int include_friendly)
 {
-    int x = start_position % 8;
-    int y = start_position / 8;
-    int directions[4][2] = {{0, -1}, {0, 1}, {-1, 0}, {1, 0}};
+    Bitboard moves = rook_attacks(start_position, game->board.occupied[WHITE] | game->board.occupied[BLACK]);
 
-    Bitboard rook_moves = 0;
-    Bitboard friendly_pieces = (game->is_white_turn == 1) ? game->board.white_pieces : game->board.black_pieces;
-    Bitboard hostile_pieces = (game->is_white_turn == 1) ? game->board.black_pieces : game->board.white_pieces;
-
-    for (int d = 0; d < 4; d++)
+    // The threat map includes defended friendly pieces, moves can't land on them
+    if (!include_friendly)
     {
-        int new_x = x;
-        int new_y = y;
-        while (1)
-        {
-            new_x += directions[d][0];
-            new_y += directions[d][1];
-
-            // Check if the new position is within bounds
-            if (new_x < 0 || new_x >= 8 || new_y < 0 || new_y >= 8)
-            {
-                break;
-            }
-
-            int new_position = new_y * 8 + new_x;
-            Bitboard mask = 1ULL << new_position;
-
-            // For threat map, include squares with friendly pieces
-            if (include_friendly)
-            {
-                rook_moves |= mask;
-                // Stop after hitting any piece (friendly or hostile)
-                if ((mask & friendly_pieces) || (mask & hostile_pieces))
-                {
-                    break;
-                }
-            }
-            else
-            {
-                // Original move calculation logic
-                if (mask & friendly_pieces)
-                {
-                    break;
-                }
-                rook_moves |= mask;
-                if (mask & hostile_pieces)
-                {
-                    break;
-                }
-            }
-        }
+        moves &= ~game->board.occupied[game->is_white_turn];
     }
-
-    return rook_moves;
+    return moves;
 }
 
 Bitboard calculate_bishop_moves(Game *game, int start_position, int include_friendly)
 {
-    static const uint64_t not_a_file = 0xfefefefefefefefe;
-    static const uint64_t not_h_file = 0x7f7f7f7f7f7f7f7f;
+    Bitboard moves = bishop_attacks(start_position, game->board.occupied[WHITE] | game->board.occupied[BLACK]);
 
-    Bitboard bishop = 1ULL << start_position;
-    Bitboard occupied = game->board.white_pieces | game->board.black_pieces;
-    Bitboard moves = 0;
-
-    // Northwest
-    Bitboard nw = bishop;
-    while (nw & not_a_file)
-    {
-        nw = (nw << 7);
-        moves |= nw;
-        if (nw & occupied)
-            break; // Stop after hitting any piece
-    }
-
-    // Northeast
-    Bitboard ne = bishop;
-    while (ne & not_h_file)
-    {
-        ne = (ne << 9);
-        moves |= ne;
-        if (ne & occupied)
-            break; // Stop after hitting any piece
-    }
-
-    // Southwest
-    Bitboard sw = bishop;
-    while (sw & not_a_file)
-    {
-        sw = (sw >> 9);
-        moves |= sw;
-        if (sw & occupied)
-            break; // Stop after hitting any piece
-    }
-
-    // Southeast
-    Bitboard se = bishop;
-    while (se & not_h_file)
-    {
-        se = (se >> 7);
-        moves |= se;
-        if (se & occupied)
-            break; // Stop after hitting any piece
-    }
-
-    // If including friendly pieces for threat map
-    if (include_friendly)
-    {
-        Bitboard friendly = game->is_white_turn ? game->board.white_pieces : game->board.black_pieces;
-        moves |= (moves & friendly);
-    }
-    else
+    // The threat map includes defended friendly pieces, moves can't land on them
+    if (!include_friendly)
     {
-        // Remove friendly pieces from possible moves
-        Bitboard friendly = game->is_white_turn ? game->board.white_pieces : game->board.black_pieces;
-        moves &= ~friendly;
+        moves &= ~game->board.occupied[game->is_white_turn];
     }
-
     return moves;
 }
 
@@ -388,245 +183,216 @@ Bitboard calculate_queen_moves(Game *game, int start_position, int include_frien
     return queen_moves;
 }
 
+// Attack tables, one bitboard of target squares per square (a8 = 0), built by the compiler
+// from the step offsets; castling and pawn pushes are handled separately. STEP is the square
+// df files and dr rows away from sq, or nothing if that falls off the board.
+#define STEP(sq, df, dr) \
+    ((unsigned)((sq) % 8 + (df)) < 8 && (unsigned)((sq) / 8 + (dr)) < 8 ? 1ULL << (((sq) + (dr) * 8 + (df)) & 63) : 0ULL)
+#define KNIGHT_STEPS(sq) (STEP(sq, 1, 2) | STEP(sq, 2, 1) | STEP(sq, 2, -1) | STEP(sq, 1, -2) | \
+                          STEP(sq, -1, -2) | STEP(sq, -2, -1) | STEP(sq, -2, 1) | STEP(sq, -1, 2))
+#define KING_STEPS(sq) (STEP(sq, 1, 0) | STEP(sq, 1, 1) | STEP(sq, 0, 1) | STEP(sq, -1, 1) | \
+                        STEP(sq, -1, 0) | STEP(sq, -1, -1) | STEP(sq, 0, -1) | STEP(sq, 1, -1))
+#define BLACK_PAWN_STEPS(sq) (STEP(sq, -1, 1) | STEP(sq, 1, 1))
+#define WHITE_PAWN_STEPS(sq) (STEP(sq, -1, -1) | STEP(sq, 1, -1))
+#define TABLE_ROW(steps, sq) steps(sq), steps(sq + 1), steps(sq + 2), steps(sq + 3), \
+                             steps(sq + 4), steps(sq + 5), steps(sq + 6), steps(sq + 7)
+#define TABLE(steps) {TABLE_ROW(steps, 0), TABLE_ROW(steps, 8), TABLE_ROW(steps, 16), TABLE_ROW(steps, 24), \
+                      TABLE_ROW(steps, 32), TABLE_ROW(steps, 40), TABLE_ROW(steps, 48), TABLE_ROW(steps, 56)}
+
+const Bitboard knight_attack_table[64] = TABLE(KNIGHT_STEPS);
+
+const Bitboard king_attack_table[64] = TABLE(KING_STEPS);
+
+// [color][square]: the two diagonals a pawn captures on, towards square 0 for white
+const Bitboard pawn_attack_table[2][64] = {TABLE(BLACK_PAWN_STEPS), TABLE(WHITE_PAWN_STEPS)};
+
 Bitboard calculate_knight_moves(Game *game, int start_position, int include_friendly)
 {
-    // Pre-calculated knight move patterns for each square
-    static const uint64_t knight_patterns[64] = {
-        0x0000000000020400ULL, 0x0000000000050800ULL, 0x00000000000A1100ULL, 0x0000000000142200ULL,
-        0x0000000000284400ULL, 0x0000000000508800ULL, 0x0000000000A01000ULL, 0x0000000000402000ULL,
-        0x0000000002040004ULL, 0x0000000005080008ULL, 0x000000000A110011ULL, 0x0000000014220022ULL,
-        0x0000000028440044ULL, 0x0000000050880088ULL, 0x00000000A0100010ULL, 0x0000000040200020ULL,
-        0x0000000204000402ULL, 0x0000000508000805ULL, 0x0000000A1100110AULL, 0x0000001422002214ULL,
-        0x0000002844004428ULL, 0x0000005088008850ULL, 0x000000A0100010A0ULL, 0x0000004020002040ULL,
-        0x0000020400040200ULL, 0x0000050800080500ULL, 0x00000A1100110A00ULL, 0x0000142200221400ULL,
-        0x0000284400442800ULL, 0x0000508800885000ULL, 0x0000A0100010A000ULL, 0x0000402000204000ULL,
-        0x0002040004020000ULL, 0x0005080008050000ULL, 0x000A1100110A0000ULL, 0x0014220022140000ULL,
-        0x0028440044280000ULL, 0x0050880088500000ULL, 0x00A0100010A00000ULL, 0x0040200020400000ULL,
-        0x0204000402000000ULL, 0x0508000805000000ULL, 0x0A1100110A000000ULL, 0x1422002214000000ULL,
-        0x2844004428000000ULL, 0x5088008850000000ULL, 0xA0100010A0000000ULL, 0x4020002040000000ULL,
-        0x0400040200000000ULL, 0x0800080500000000ULL, 0x1100110A00000000ULL, 0x2200221400000000ULL,
-        0x4400442800000000ULL, 0x8800885000000000ULL, 0x100010A000000000ULL, 0x2000204000000000ULL,
-        0x0004020000000000ULL, 0x0008050000000000ULL, 0x00110A0000000000ULL, 0x0022140000000000ULL,
-        0x0044280000000000ULL, 0x0088500000000000ULL, 0x0010A00000000000ULL, 0x0020400000000000ULL};
-
-    Bitboard moves = knight_patterns[start_position];
+    Bitboard moves = knight_attack_table[start_position];
 
     // If we don't want to include friendly pieces, mask them out
     if (!include_friendly)
     {
-        Bitboard friendly_pieces = game->is_white_turn ? game->board.white_pieces : game->board.black_pieces;
-        moves &= ~friendly_pieces;
+        moves &= ~game->board.occupied[game->is_white_turn];
     }
 
     return moves;
 }
 
-Bitboard calculate_king_moves(Game *game, int start_position)
+// Castling targets of the side to move: the right must still be there, the squares between
+// king and rook empty, and the king may not be in check or pass over or land on an attacked square
+static Bitboard castling_moves(Game *game)
 {
-    // Calculate x,y coordinates from the start_position
-    int x = start_position % 8;
-    int y = start_position / 8;
-
-    int king_moves[8][2] = {
-        {-1, -1}, {-1, 0}, {-1, 1}, {0, -1}, {0, 1}, {1, -1}, {1, 0}, {1, 1}};
+    int color = game->is_white_turn;
+    int rights = game->board.castling & (color == WHITE ? CASTLE_WHITE_SHORT | CASTLE_WHITE_LONG : CASTLE_BLACK_SHORT | CASTLE_BLACK_LONG);
+    if (rights == 0)
+    {
+        return 0;
+    }
 
-    Bitboard king_move = 0;
-    Bitboard friendly_pieces = game->is_white_turn ? game->board.white_pieces : game->board.black_pieces;
+    // For each side: the right, the king's target, the squares that must be empty and the
+    // squares (king's start included) that must not be attacked
+    static const struct
+    {
+        int right;
+        int target;
+        Bitboard path;
+        Bitboard safe;
+    } castles[4] = {
+        {CASTLE_WHITE_SHORT, 62, 0x6000000000000000ULL, 0x7000000000000000ULL}, // e1-g1, f1 g1 empty
+        {CASTLE_WHITE_LONG, 58, 0x0E00000000000000ULL, 0x1C00000000000000ULL},  // e1-c1, b1 c1 d1 empty
+        {CASTLE_BLACK_SHORT, 6, 0x0000000000000060ULL, 0x0000000000000070ULL},  // e8-g8, f8 g8 empty
+        {CASTLE_BLACK_LONG, 2, 0x000000000000000EULL, 0x000000000000001CULL}};  // e8-c8, b8 c8 d8 empty
 
-    // Get enemy king's position
-    Bitboard enemy_king = game->is_white_turn ? game->board.black_king : game->board.white_king;
-    int enemy_king_pos = Bitboard_to_position(enemy_king);
-    int enemy_king_x = enemy_king_pos % 8;
-    int enemy_king_y = enemy_king_pos / 8;
+    Bitboard occupied = game->board.occupied[WHITE] | game->board.occupied[BLACK];
+    Bitboard targets = 0;
 
-    // Check each possible move direction
-    for (int i = 0; i < 8; i++)
+    for (int i = 0; i < 4; i++)
     {
-        int new_x = x + king_moves[i][0];
-        int new_y = y + king_moves[i][1];
-
-        // Check if the new position is within bounds
-        if (new_x >= 0 && new_x < 8 && new_y >= 0 && new_y < 8)
+        if (!(rights & castles[i].right) || (occupied & castles[i].path))
         {
-            // Check if move is at least one square away from enemy king
-            int dx = abs(new_x - enemy_king_x);
-            int dy = abs(new_y - enemy_king_y);
-
-            // Skip if too close to enemy king (adjacent squares including diagonals)
-            if (dx <= 1 && dy <= 1)
-            {
-                continue;
-            }
-
-            int new_position = new_y * 8 + new_x;
-            Bitboard mask = 1ULL << new_position;
-
-            // Only add the move if it's not occupied by a friendly piece
-            if (!(mask & friendly_pieces))
-            {
-                king_move |= mask;
-            }
+            continue;
         }
-    }
 
-    // castling
-    if (game->isCheck == -1)
-    {
-        Bitboard squares_in_between = 0; // squares between king and rook
-        if (game->human_color == 1)
+        int attacked = 0;
+        Bitboard safe = castles[i].safe;
+        while (safe && !attacked)
         {
-            if (game->board.white_king_moved == 0 && game->is_white_turn == 1)
-            {
-                squares_in_between = position_to_Bitboard(57) | position_to_Bitboard(58) | position_to_Bitboard(59);
-                if (game->board.rook_on56_moved == 0 && (game->board.white_pieces & squares_in_between) == 0)
-                {
-                    king_move |= position_to_Bitboard(58); // c1
-                }
-                squares_in_between = position_to_Bitboard(61) | position_to_Bitboard(62);
-                if (game->board.rook_on63_moved == 0 && (game->board.white_pieces & squares_in_between) == 0)
-                {
-                    king_move |= position_to_Bitboard(62); // g1
-                }
-            }
-            if (game->board.black_king_moved == 0 && game->is_white_turn == 0)
-            {
-                squares_in_between = position_to_Bitboard(1) | position_to_Bitboard(2) | position_to_Bitboard(3);
-                if (game->board.rook_on0_moved == 0 && (game->board.black_pieces & squares_in_between) == 0)
-                {
-                    king_move |= position_to_Bitboard(2); // c8
-                }
-                squares_in_between = position_to_Bitboard(5) | position_to_Bitboard(6);
-                if (game->board.rook_on7_moved == 0 && (game->board.black_pieces & squares_in_between) == 0)
-                {
-                    king_move |= position_to_Bitboard(6); // g8
-                }
-            }
+            attacked = is_square_attacked(&game->board, get_and_clear_LSB(&safe), !color);
         }
-        else if (game->human_color == 0)
+        if (!attacked)
         {
-            if (game->board.white_king_moved == 0 && game->is_white_turn == 1)
-            {
-                squares_in_between = position_to_Bitboard(1) | position_to_Bitboard(2);
-                if (game->board.rook_on0_moved == 0 && (game->board.white_pieces & squares_in_between) == 0)
-                {
-                    king_move |= position_to_Bitboard(1);
-                }
-                squares_in_between = position_to_Bitboard(4) | position_to_Bitboard(5) | position_to_Bitboard(6);
-                if (game->board.rook_on7_moved == 0 && (game->board.white_pieces & squares_in_between) == 0)
-                {
-                    king_move |= position_to_Bitboard(5);
-                }
-            }
-            else if (game->board.black_king_moved == 0 && game->is_white_turn == 0)
-            {
-                squares_in_between = position_to_Bitboard(57) | position_to_Bitboard(58);
-                if (game->board.rook_on56_moved == 0 && (game->board.black_pieces & squares_in_between) == 0)
-                {
-                    king_move |= position_to_Bitboard(57);
-                }
-                squares_in_between = position_to_Bitboard(60) | position_to_Bitboard(61) | position_to_Bitboard(62);
-                if (game->board.rook_on63_moved == 0 && (game->board.black_pieces & squares_in_between) == 0)
-                {
-                    king_move |= position_to_Bitboard(61);
-                }
-            }
+            targets |= position_to_Bitboard(castles[i].target);
         }
     }
-    return king_move;
+    return targets;
 }
 
-void update_threat_map(Game *game)
+// King targets of the side to move, castling included. Squares next to the enemy king are left out.
+Bitboard calculate_king_moves(Game *game, int start_position)
 {
-    // Update combined piece positions
-    game->board.white_pieces = game->board.white_pawns | game->board.white_knights | game->board.white_bishops | game->board.white_rooks | game->board.white_queens | game->board.white_king;
-    game->board.black_pieces = game->board.black_pawns | game->board.black_knights | game->board.black_bishops | game->board.black_rooks | game->board.black_queens | game->board.black_king;
+    Bitboard king_move = king_attack_table[start_position] & ~game->board.occupied[game->is_white_turn];
 
-    game->board.white_threat_map = 0;
-    game->board.black_threat_map = 0;
+    Bitboard enemy_king = game->board.pieces[!game->is_white_turn][KING];
+    if (enemy_king)
+    {
+        king_move &= ~king_attack_table[Bitboard_to_position(enemy_king)];
+    }
 
-    game->white_king = Bitboard_to_position(game->board.white_king);
-    game->black_king = Bitboard_to_position(game->board.black_king);
+    return king_move | castling_moves(game);
+}
 
-    int original_turn = game->is_white_turn;
+// Four bitboards in one vector, one lane per direction; GCC turns the lane-wise shifts,
+// ANDs and ORs into SIMD instructions (two 128-bit operations each, one with AVX2)
+typedef Bitboard Bitboard4 __attribute__((vector_size(4 * sizeof(Bitboard))));
 
-    // Calculate white threats
-    game->is_white_turn = 1; // Set to black's turn to calculate white threats
-    Bitboard piece_bb = game->board.white_pawns;
-    while (piece_bb)
-    {
-        int pos = get_and_clear_LSB(&piece_bb);
-        game->board.white_threat_map |= calculate_pawn_moves(game, pos, 1);
-    }
-    piece_bb = game->board.white_knights;
-    while (piece_bb)
-    {
-        int pos = get_and_clear_LSB(&piece_bb);
-        game->board.white_threat_map |= calculate_knight_moves(game, pos, 1);
-    }
-    piece_bb = game->board.white_bishops;
-    while (piece_bb)
-    {
-        int pos = get_and_clear_LSB(&piece_bb);
-        game->board.white_threat_map |= calculate_bishop_moves(game, pos, 1);
-    }
-    piece_bb = game->board.white_rooks;
-    while (piece_bb)
-    {
-        int pos = get_and_clear_LSB(&piece_bb);
-        game->board.white_threat_map |= calculate_rook_moves(game, pos, 1);
-    }
-    piece_bb = game->board.white_queens;
-    while (piece_bb)
-    {
-        int pos = get_and_clear_LSB(&piece_bb);
-        game->board.white_threat_map |= calculate_queen_moves(game, pos, 1);
-    }
-    piece_bb = game->board.white_king;
-    while (piece_bb)
-    {
-        int pos = get_and_clear_LSB(&piece_bb);
-        game->board.white_threat_map |= calculate_king_moves(game, pos);
-    }
+// Squares attacked by all sliders at once with Kogge-Stone occluded fills. The attackers
+// are filled through empty squares in eight directions, four per vector: the ones that
+// increase the square number (east, south, south-east, south-west) are left shifts, the
+// other four are right shifts. The masks keep a fill from wrapping around the board edge.
+static Bitboard slider_attacks(Bitboard orthogonal, Bitboard diagonal, Bitboard empty)
+{
+    const Bitboard4 shift = {1, 8, 9, 7};
+    const Bitboard4 up_mask = {~FILE_A, ~0ULL, ~FILE_A, ~FILE_H};   // E, S, SE, SW
+    const Bitboard4 down_mask = {~FILE_H, ~0ULL, ~FILE_H, ~FILE_A}; // W, N, NW, NE
+
+    Bitboard4 up = {orthogonal, orthogonal, diagonal, diagonal};
+    Bitboard4 down = up;
+    Bitboard4 up_empty = (Bitboard4){empty, empty, empty, empty} & up_mask;
+    Bitboard4 down_empty = (Bitboard4){empty, empty, empty, empty} & down_mask;
+
+    // Each step doubles the distance covered: 1, 2 and 4 squares
+    up |= up_empty & (up << shift);
+    up_empty &= up_empty << shift;
+    down |= down_empty & (down >> shift);
+    down_empty &= down_empty >> shift;
+    up |= up_empty & (up << (shift * 2));
+    up_empty &= up_empty << (shift * 2);
+    down |= down_empty & (down >> (shift * 2));
+    down_empty &= down_empty >> (shift * 2);
+    up |= up_empty & (up << (shift * 4));
+    down |= down_empty & (down >> (shift * 4));
+
+    // One more step onto the first blocker, which is attacked too
+    Bitboard4 attacks = ((up << shift) & up_mask) | ((down >> shift) & down_mask);
+    return attacks[0] | attacks[1] | attacks[2] | attacks[3];
+}
 
-    // Calculate black threats
-    game->is_white_turn = 0; // Set to white's turn to calculate black threats
-    piece_bb = game->board.black_pawns;
-    while (piece_bb)
-    {
-        int pos = get_and_clear_LSB(&piece_bb);
-        game->board.black_threat_map |= calculate_pawn_moves(game, pos, 1);
-    }
-    piece_bb = game->board.black_knights;
-    while (piece_bb)
-    {
-        int pos = get_and_clear_LSB(&piece_bb);
-        game->board.black_threat_map |= calculate_knight_moves(game, pos, 1);
-    }
-    piece_bb = game->board.black_bishops;
-    while (piece_bb)
-    {
-        int pos = get_and_clear_LSB(&piece_bb);
-        game->board.black_threat_map |= calculate_bishop_moves(game, pos, 1);
-    }
-    piece_bb = game->board.black_rooks;
-    while (piece_bb)
-    {
-        int pos = get_and_clear_LSB(&piece_bb);
-        game->board.black_threat_map |= calculate_rook_moves(game, pos, 1);
-    }
-    piece_bb = game->board.black_queens;
-    while (piece_bb)
-    {
-        int pos = get_and_clear_LSB(&piece_bb);
-        game->board.black_threat_map |= calculate_queen_moves(game, pos, 1);
-    }
-    piece_bb = game->board.black_king;
-    while (piece_bb)
-    {
-        int pos = get_and_clear_LSB(&piece_bb);
-        game->board.black_threat_map |= calculate_king_moves(game, pos);
-    }
+// Squares attacked by a set of knights
+static Bitboard knight_attacks(Bitboard knights)
+{
+    Bitboard not_ab = ~(FILE_A | (FILE_A << 1));
+    Bitboard not_gh = ~(FILE_H | (FILE_H >> 1));
+    return ((knights << 17) & ~FILE_A) | ((knights << 15) & ~FILE_H) | ((knights << 10) & not_ab) | ((knights << 6) & not_gh) |
+           ((knights >> 17) & ~FILE_H) | ((knights >> 15) & ~FILE_A) | ((knights >> 10) & not_gh) | ((knights >> 6) & not_ab);
+}
 
-    // Restore original turn
-    game->is_white_turn = original_turn;
+// Squares attacked by a set of kings (castling is a move, not an attack)
+static Bitboard king_attacks(Bitboard kings)
+{
+    Bitboard sideways = ((kings << 1) & ~FILE_A) | ((kings >> 1) & ~FILE_H);
+    Bitboard row = kings | sideways;
+    return sideways | (row << 8) | (row >> 8);
+}
+
+// Squares attacked by the pieces of one color, built for the whole side at once: a fixed
+// number of shifts however many pieces there are. Squares of the own pieces count too.
+// The GUI uses it to mark the moves that put the piece on an attacked square.
+Bitboard calculate_threat_map(Game *game, int color)
+{
+    const Bitboard *own = game->board.pieces[color];
+    Bitboard empty = ~(game->board.occupied[WHITE] | game->board.occupied[BLACK]);
+
+    return pawn_attacks(own[PAWN], color) | knight_attacks(own[KNIGHT]) | king_attacks(own[KING]) |
+           slider_attacks(own[ROOK] | own[QUEEN], own[BISHOP] | own[QUEEN], empty);
+}
+
+// Pieces of by_color attacking square, found by looking back from the square: a knight
+// attacks it if a knight on the square would attack the knight, and so on for every piece
+Bitboard attackers_to(const ChessBoard *board, int square, int by_color)
+{
+    const Bitboard *their = board->pieces[by_color];
+    Bitboard attackers = (pawn_attack_table[!by_color][square] & their[PAWN]) |
+                         (knight_attack_table[square] & their[KNIGHT]) |
+                         (king_attack_table[square] & their[KING]);
+
+    Bitboard orthogonal = their[ROOK] | their[QUEEN];
+    Bitboard diagonal = their[BISHOP] | their[QUEEN];
+    Bitboard occupied = board->occupied[WHITE] | board->occupied[BLACK];
+    if (orthogonal)
+        attackers |= rook_attacks(square, occupied) & orthogonal;
+    if (diagonal)
+        attackers |= bishop_attacks(square, occupied) & diagonal;
+    return attackers;
+}
+
+// Pieces of both colors attacking square when only the squares in occupied hold pieces.
+// Taking pieces out of occupied uncovers the sliders behind them (x-rays).
+Bitboard all_attackers_to(const ChessBoard *board, int square, Bitboard occupied)
+{
+    const Bitboard(*pieces)[6] = board->pieces;
+    Bitboard orthogonal = pieces[WHITE][ROOK] | pieces[WHITE][QUEEN] | pieces[BLACK][ROOK] | pieces[BLACK][QUEEN];
+    Bitboard diagonal = pieces[WHITE][BISHOP] | pieces[WHITE][QUEEN] | pieces[BLACK][BISHOP] | pieces[BLACK][QUEEN];
+
+    Bitboard attackers = (pawn_attack_table[BLACK][square] & pieces[WHITE][PAWN]) |
+                         (pawn_attack_table[WHITE][square] & pieces[BLACK][PAWN]) |
+                         (knight_attack_table[square] & (pieces[WHITE][KNIGHT] | pieces[BLACK][KNIGHT])) |
+                         (king_attack_table[square] & (pieces[WHITE][KING] | pieces[BLACK][KING])) |
+                         (rook_attacks(square, occupied) & orthogonal) |
+                         (bishop_attacks(square, occupied) & diagonal);
+    return attackers & occupied;
+}
+
+int is_square_attacked(const ChessBoard *board, int square, int by_color)
+{
+    return attackers_to(board, square, by_color) != 0;
+}
+
+// Pieces giving check to the side to move
+Bitboard checkers(const Game *game)
+{
+    Bitboard king = game->board.pieces[game->is_white_turn][KING];
+    if (king == 0)
+        return 0;
+    return attackers_to(&game->board, Bitboard_to_position(king), !game->is_white_turn);
 }
@@ -0,0 +1,628 @@
+#include "chessEngine.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Win/draw bitbases for king + material against a lone king.
+//
+// Positions are indexed with the strong side as white (square 0 = a8, pawns move towards square 0):
+//   index = (((piece2 * 64 + piece1) * 64 + weak_king) * 64 + strong_king) * 2 + side
+// side 0 means the strong side is to move. A set bit means the strong side wins, a clear
+// bit means a draw (or an illegal position). The lone king can never win.
+
+#define BITBASE_MAGIC "PCBB"
+
+static const struct
+{
+    const char *name;
+    int num_pieces;
+    char pieces[2];
+} signatures[BITBASE_COUNT] = {
+    {"kqk", 1, {'Q', '.'}},
+    {"krk", 1, {'R', '.'}},
+    {"kpk", 1, {'P', '.'}},
+    {"kbnk", 2, {'B', 'N'}},
+};
+
+// File header in front of the bit-packed table
+typedef struct
+{
+    char magic[4];
+    uint32_t signature;
+    uint64_t num_positions;
+} BitbaseHeader;
+
+// ---------------------------------------------------------------------------
+// Attack helpers (independent of Game so the generator can run on raw squares)
+
+static Bitboard piece_attacks(char piece, int square, Bitboard occupied)
+{
+    switch (piece)
+    {
+    case 'K':
+        return king_attack_table[square];
+    case 'N':
+        return knight_attack_table[square];
+    case 'B':
+        return bishop_attacks(square, occupied);
+    case 'R':
+        return rook_attacks(square, occupied);
+    case 'Q':
+        return rook_attacks(square, occupied) | bishop_attacks(square, occupied);
+    case 'P':
+        return pawn_attack_table[WHITE][square];
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Generator
+
+#define VALUE_UNKNOWN 0
+#define VALUE_WIN 1
+#define VALUE_DRAW 2
+#define VALUE_INVALID 3
+
+typedef struct
+{
+    int side;        // 0 strong side to move, 1 lone king to move
+    int strong_king;
+    int weak_king;
+    int piece[2];
+} BitbasePosition;
+
+typedef struct
+{
+    int signature;
+    int num_pieces;
+    const char *pieces;
+    size_t size;
+    uint8_t *values;
+    uint8_t *counters;       // legal moves of lone-king positions not yet known to lose
+    uint64_t *frontier;      // positions that became wins in the previous pass
+    uint64_t *next_frontier; // positions that become wins in this pass
+    const uint8_t *queen_bits; // finished KQK and KRK tables, used for promotions
+    const uint8_t *rook_bits;
+} BitbaseGenerator;
+
+typedef struct
+{
+    BitbaseGenerator *generator;
+    size_t start, end;
+} BitbaseTask;
+
+static size_t encode_position(int num_pieces, const BitbasePosition *p)
+{
+    size_t index = num_pieces == 2 ? (size_t)p->piece[1] * 64 + p->piece[0] : (size_t)p->piece[0];
+    return ((index * 64 + p->weak_king) * 64 + p->strong_king) * 2 + p->side;
+}
+
+static void decode_position(int num_pieces, size_t index, BitbasePosition *p)
+{
+    p->side = index % 2;
+    index /= 2;
+    p->strong_king = index % 64;
+    index /= 64;
+    p->weak_king = index % 64;
+    index /= 64;
+    p->piece[0] = index % 64;
+    p->piece[1] = num_pieces == 2 ? (int)(index / 64) : -1;
+}
+
+static Bitboard strong_occupancy(const BitbaseGenerator *g, const BitbasePosition *p)
+{
+    Bitboard occupied = position_to_Bitboard(p->strong_king);
+    for (int i = 0; i < g->num_pieces; i++)
+        occupied |= position_to_Bitboard(p->piece[i]);
+    return occupied;
+}
+
+// Squares attacked by the strong side; the piece on skip_square (if any) is ignored
+static Bitboard strong_attacks(const BitbaseGenerator *g, const BitbasePosition *p, Bitboard occupied, int skip_square)
+{
+    Bitboard attacks = king_attack_table[p->strong_king];
+    for (int i = 0; i < g->num_pieces; i++)
+    {
+        if (p->piece[i] != skip_square)
+            attacks |= piece_attacks(g->pieces[i], p->piece[i], occupied);
+    }
+    return attacks;
+}
+
+static int position_valid(const BitbaseGenerator *g, const BitbasePosition *p)
+{
+    Bitboard seen = position_to_Bitboard(p->strong_king);
+    if (seen & position_to_Bitboard(p->weak_king))
+        return 0;
+    seen |= position_to_Bitboard(p->weak_king);
+
+    for (int i = 0; i < g->num_pieces; i++)
+    {
+        if (seen & position_to_Bitboard(p->piece[i]))
+            return 0;
+        if (g->pieces[i] == 'P' && (p->piece[i] < 8 || p->piece[i] >= 56))
+            return 0;
+        seen |= position_to_Bitboard(p->piece[i]);
+    }
+
+    if (king_attack_table[p->strong_king] & position_to_Bitboard(p->weak_king))
+        return 0;
+
+    // the side that just moved can't have left the lone king in check
+    if (p->side == 0 && (strong_attacks(g, p, seen, -1) & position_to_Bitboard(p->weak_king)))
+        return 0;
+
+    return 1;
+}
+
+static int bit_set(const uint8_t *bits, size_t index)
+{
+    return (bits[index / 8] >> (index % 8)) & 1;
+}
+
+// Value of a strong-to-move position before any retrograde pass
+static int initial_strong_value(const BitbaseGenerator *g, const BitbasePosition *p)
+{
+    Bitboard occupied = strong_occupancy(g, p) | position_to_Bitboard(p->weak_king);
+
+    // promotions lead into the finished KQK / KRK tables with the lone king to move
+    for (int i = 0; i < g->num_pieces; i++)
+    {
+        int square = p->piece[i];
+        if (g->pieces[i] != 'P' || square >= 16 || (occupied & position_to_Bitboard(square - 8)))
+            continue;
+
+        BitbasePosition promoted = *p;
+        promoted.side = 1;
+        promoted.piece[0] = square - 8;
+        size_t index = encode_position(1, &promoted);
+        if ((g->queen_bits != NULL && bit_set(g->queen_bits, index)) ||
+            (g->rook_bits != NULL && bit_set(g->rook_bits, index)))
+            return VALUE_WIN;
+    }
+
+    // a strong side without any move is stalemated
+    Bitboard king_targets = king_attack_table[p->strong_king] & ~occupied & ~king_attack_table[p->weak_king];
+    if (king_targets)
+        return VALUE_UNKNOWN;
+    for (int i = 0; i < g->num_pieces; i++)
+    {
+        if (g->pieces[i] == 'P')
+        {
+            if (!(occupied & position_to_Bitboard(p->piece[i] - 8)))
+                return VALUE_UNKNOWN;
+        }
+        else if (piece_attacks(g->pieces[i], p->piece[i], occupied) & ~occupied)
+        {
+            return VALUE_UNKNOWN;
+        }
+    }
+    return VALUE_DRAW;
+}
+
+// Value of a lone-king-to-move position before any retrograde pass; counts its legal moves
+static int initial_weak_value(const BitbaseGenerator *g, const BitbasePosition *p, uint8_t *moves)
+{
+    Bitboard strong = strong_occupancy(g, p);
+    Bitboard targets = king_attack_table[p->weak_king] & ~king_attack_table[p->strong_king] & ~position_to_Bitboard(p->strong_king);
+    int count = 0;
+
+    while (targets)
+    {
+        int target = get_and_clear_LSB(&targets);
+        Bitboard occupied = strong | position_to_Bitboard(target);
+        if (strong & position_to_Bitboard(target))
+        {
+            // capturing the only piece (or one of two) always leaves a draw
+            if (!(strong_attacks(g, p, occupied, target) & position_to_Bitboard(target)))
+                return VALUE_DRAW;
+        }
+        else if (!(strong_attacks(g, p, occupied, -1) & position_to_Bitboard(target)))
+        {
+            count++;
+        }
+    }
+
+    *moves = (uint8_t)count;
+    if (count > 0)
+        return VALUE_UNKNOWN;
+
+    int in_check = (strong_attacks(g, p, strong | position_to_Bitboard(p->weak_king), -1) & position_to_Bitboard(p->weak_king)) != 0;
+    return in_check ? VALUE_WIN : VALUE_DRAW;
+}
+
+static void mark_win(BitbaseGenerator *g, size_t index)
+{
+    uint8_t expected = VALUE_UNKNOWN;
+    if (__atomic_compare_exchange_n(&g->values[index], &expected, VALUE_WIN, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        __atomic_fetch_or(&g->next_frontier[index / 64], 1ULL << (index % 64), __ATOMIC_RELAXED);
+}
+
+static void *initialize_range(void *arg)
+{
+    BitbaseTask *task = (BitbaseTask *)arg;
+    BitbaseGenerator *g = task->generator;
+
+    for (size_t index = task->start; index < task->end; index++)
+    {
+        BitbasePosition p;
+        decode_position(g->num_pieces, index, &p);
+
+        if (!position_valid(g, &p))
+            g->values[index] = VALUE_INVALID;
+        else if (p.side == 0)
+            g->values[index] = initial_strong_value(g, &p);
+        else
+            g->values[index] = initial_weak_value(g, &p, &g->counters[index]);
+
+        if (g->values[index] == VALUE_WIN)
+            __atomic_fetch_or(&g->next_frontier[index / 64], 1ULL << (index % 64), __ATOMIC_RELAXED);
+    }
+    return NULL;
+}
+
+// Un-moves the strong side: every strong-to-move predecessor of a lost lone-king position is won
+static void propagate_weak_loss(BitbaseGenerator *g, const BitbasePosition *p)
+{
+    Bitboard occupied = strong_occupancy(g, p) | position_to_Bitboard(p->weak_king);
+    BitbasePosition previous = *p;
+    previous.side = 0;
+
+    Bitboard origins = king_attack_table[p->strong_king] & ~occupied;
+    while (origins)
+    {
+        previous.strong_king = get_and_clear_LSB(&origins);
+        if (position_valid(g, &previous))
+            mark_win(g, encode_position(g->num_pieces, &previous));
+    }
+    previous.strong_king = p->strong_king;
+
+    for (int i = 0; i < g->num_pieces; i++)
+    {
+        int square = p->piece[i];
+        if (g->pieces[i] == 'P')
+        {
+            origins = 0;
+            if (square + 8 < 56 && !(occupied & position_to_Bitboard(square + 8)))
+            {
+                origins |= position_to_Bitboard(square + 8);
+                if (square >= 32 && square < 40 && !(occupied & position_to_Bitboard(square + 16)))
+                    origins |= position_to_Bitboard(square + 16);
+            }
+        }
+        else
+        {
+            origins = piece_attacks(g->pieces[i], square, occupied) & ~occupied;
+        }
+
+        while (origins)
+        {
+            previous.piece[i] = get_and_clear_LSB(&origins);
+            if (position_valid(g, &previous))
+                mark_win(g, encode_position(g->num_pieces, &previous));
+        }
+        previous.piece[i] = square;
+    }
+}
+
+// Un-moves the lone king: a lone-king-to-move predecessor loses once all of its moves lose
+static void propagate_strong_win(BitbaseGenerator *g, const BitbasePosition *p)
+{
+    Bitboard occupied = strong_occupancy(g, p) | position_to_Bitboard(p->weak_king);
+    BitbasePosition previous = *p;
+    previous.side = 1;
+
+    Bitboard origins = king_attack_table[p->weak_king] & ~occupied & ~king_attack_table[p->strong_king];
+    while (origins)
+    {
+        previous.weak_king = get_and_clear_LSB(&origins);
+        size_t index = encode_position(g->num_pieces, &previous);
+        if (__atomic_load_n(&g->values[index], __ATOMIC_RELAXED) != VALUE_UNKNOWN)
+            continue;
+        if (__atomic_sub_fetch(&g->counters[index], 1, __ATOMIC_RELAXED) == 0)
+            mark_win(g, index);
+    }
+}
+
+static void *propagate_range(void *arg)
+{
+    BitbaseTask *task = (BitbaseTask *)arg;
+    BitbaseGenerator *g = task->generator;
+
+    for (size_t word = task->start / 64; word < (task->end + 63) / 64; word++)
+    {
+        uint64_t bits = g->frontier[word];
+        while (bits)
+        {
+            size_t index = word * 64 + get_and_clear_LSB(&bits);
+            BitbasePosition p;
+            decode_position(g->num_pieces, index, &p);
+            if (p.side == 1)
+                propagate_weak_loss(g, &p);
+            else
+                propagate_strong_win(g, &p);
+        }
+    }
+    return NULL;
+}
+
+// Runs fn over the whole index space split into one contiguous range per thread
+static void run_parallel(BitbaseGenerator *g, int num_threads, void *(*fn)(void *))
+{
+    pthread_t threads[64];
+    BitbaseTask tasks[64];
+    if (num_threads > 64)
+        num_threads = 64;
+
+    // ranges are whole frontier words so threads never share one
+    size_t words = (g->size + 63) / 64;
+    for (int t = 0; t < num_threads; t++)
+    {
+        tasks[t].generator = g;
+        tasks[t].start = words * t / num_threads * 64;
+        tasks[t].end = words * (t + 1) / num_threads * 64;
+        if (tasks[t].end > g->size)
+            tasks[t].end = g->size;
+        pthread_create(&threads[t], NULL, fn, &tasks[t]);
+    }
+    for (int t = 0; t < num_threads; t++)
+        pthread_join(threads[t], NULL);
+}
+
+// Generates one table by retrograde analysis and returns it bit-packed (NULL on failure)
+static uint8_t *generate_table(int signature, int num_threads, const uint8_t *queen_bits, const uint8_t *rook_bits)
+{
+    BitbaseGenerator g;
+    g.signature = signature;
+    g.num_pieces = signatures[signature].num_pieces;
+    g.pieces = signatures[signature].pieces;
+    g.size = (size_t)2 * 64 * 64 * (g.num_pieces == 2 ? 64 * 64 : 64);
+    g.queen_bits = queen_bits;
+    g.rook_bits = rook_bits;
+
+    size_t words = (g.size + 63) / 64;
+    g.values = (uint8_t *)calloc(g.size, 1);
+    g.counters = (uint8_t *)calloc(g.size, 1);
+    g.frontier = (uint64_t *)calloc(words, sizeof(uint64_t));
+    g.next_frontier = (uint64_t *)calloc(words, sizeof(uint64_t));
+    uint8_t *bits = (uint8_t *)calloc((g.size + 7) / 8, 1);
+    if (g.values == NULL || g.counters == NULL || g.frontier == NULL || g.next_frontier == NULL || bits == NULL)
+    {
+        printf("ERROR: Failed to allocate the %s generator\n", signatures[signature].name);
+        free(g.values);
+        free(g.counters);
+        free(g.frontier);
+        free(g.next_frontier);
+        free(bits);
+        return NULL;
+    }
+
+    // mates, stalemates, drawing captures and winning promotions
+    run_parallel(&g, num_threads, initialize_range);
+
+    int passes = 0;
+    while (1)
+    {
+        uint64_t *temp = g.frontier;
+        g.frontier = g.next_frontier;
+        g.next_frontier = temp;
+        memset(g.next_frontier, 0, words * sizeof(uint64_t));
+
+        int empty = 1;
+        for (size_t i = 0; i < words && empty; i++)
+            empty = g.frontier[i] == 0;
+        if (empty)
+            break;
+
+        run_parallel(&g, num_threads, propagate_range);
+        passes++;
+    }
+
+    size_t wins = 0;
+    for (size_t index = 0; index < g.size; index++)
+    {
+        if (g.values[index] == VALUE_WIN)
+        {
+            bits[index / 8] |= 1 << (index % 8);
+            wins++;
+        }
+    }
+    printf("%-5s %10zu positions, %10zu wins, %3d passes\n", signatures[signature].name, g.size, wins, passes);
+
+    free(g.values);
+    free(g.counters);
+    free(g.frontier);
+    free(g.next_frontier);
+    return bits;
+}
+
+static int write_table(const char *dir, int signature, const uint8_t *bits)
+{
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s.bb", dir, signatures[signature].name);
+
+    FILE *file = fopen(path, "wb");
+    if (file == NULL)
+    {
+        printf("ERROR: unable to create %s\n", path);
+        return 0;
+    }
+
+    BitbaseHeader header;
+    memcpy(header.magic, BITBASE_MAGIC, 4);
+    header.signature = signature;
+    header.num_positions = (uint64_t)2 * 64 * 64 * (signatures[signature].num_pieces == 2 ? 64 * 64 : 64);
+
+    size_t bytes = (header.num_positions + 7) / 8;
+    int success = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(bits, 1, bytes, file) == bytes;
+    fclose(file);
+    if (!success)
+        printf("ERROR: unable to write %s\n", path);
+    return success;
+}
+
+// Generates all bitbases into dir. KQK and KRK come first because KPK promotes into them.
+int generate_bitbases(const char *dir, int num_threads)
+{
+    if (num_threads < 1)
+        num_threads = 1;
+
+    uint8_t *tables[BITBASE_COUNT] = {NULL};
+    int success = 1;
+    for (int signature = 0; signature < BITBASE_COUNT && success; signature++)
+    {
+        tables[signature] = generate_table(signature, num_threads, tables[BITBASE_KQK], tables[BITBASE_KRK]);
+        success = tables[signature] != NULL && write_table(dir, signature, tables[signature]);
+    }
+
+    for (int signature = 0; signature < BITBASE_COUNT; signature++)
+        free(tables[signature]);
+    return success;
+}
+
+// ---------------------------------------------------------------------------
+// Probing
+
+// Maps every bitbase file found in dir. Missing files are simply not probed.
+Bitbases *bitbases_open(const char *dir)
+{
+    Bitbases *bitbases = (Bitbases *)calloc(1, sizeof(Bitbases));
+    if (bitbases == NULL)
+    {
+        printf("ERROR: Failed to create bitbases\n");
+        return NULL;
+    }
+
+    for (int signature = 0; signature < BITBASE_COUNT; signature++)
+    {
+        char path[512];
+        snprintf(path, sizeof(path), "%s/%s.bb", dir, signatures[signature].name);
+
+        int fd = open(path, O_RDONLY);
+        if (fd < 0)
+            continue;
+
+        struct stat st;
+        if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(BitbaseHeader))
+        {
+            close(fd);
+            continue;
+        }
+
+        void *data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (data == MAP_FAILED)
+            continue;
+
+        const BitbaseHeader *header = (const BitbaseHeader *)data;
+        if (memcmp(header->magic, BITBASE_MAGIC, 4) != 0 || header->signature != (uint32_t)signature ||
+            (size_t)st.st_size < sizeof(BitbaseHeader) + (header->num_positions + 7) / 8)
+        {
+            printf("ERROR: %s is not a valid bitbase\n", path);
+            munmap(data, st.st_size);
+            continue;
+        }
+
+        bitbases->mapping[signature] = data;
+        bitbases->mapping_size[signature] = st.st_size;
+        bitbases->bits[signature] = (const uint8_t *)data + sizeof(BitbaseHeader);
+    }
+    return bitbases;
+}
+
+void bitbases_close(Bitbases *bitbases)
+{
+    if (bitbases == NULL)
+        return;
+
+    for (int signature = 0; signature < BITBASE_COUNT; signature++)
+    {
+        if (bitbases->mapping[signature] != NULL)
+            munmap(bitbases->mapping[signature], bitbases->mapping_size[signature]);
+    }
+    free(bitbases);
+}
+
+// Looks the position up in the matching bitbase.
+// Returns 1 and sets *result (1 white wins, 0 draw, -1 black wins) if the material is covered.
+int bitbase_probe(const Bitbases *bitbases, const Game *game, int *result)
+{
+    if (bitbases == NULL)
+        return 0;
+
+    const ChessBoard *board = &game->board;
+    int white_strong;
+    if (board->occupied[BLACK] == board->pieces[BLACK][KING])
+        white_strong = 1;
+    else if (board->occupied[WHITE] == board->pieces[WHITE][KING])
+        white_strong = 0;
+    else
+        return 0;
+
+    const Bitboard *own = board->pieces[white_strong];
+    Bitboard strong = board->occupied[white_strong] & ~own[KING];
+    Bitboard pawns = own[PAWN];
+    Bitboard knights = own[KNIGHT];
+    Bitboard bishops = own[BISHOP];
+    Bitboard rooks = own[ROOK];
+    Bitboard queens = own[QUEEN];
+
+    int signature;
+    Bitboard first, second = 0;
+    if (strong == queens && __builtin_popcountll(queens) == 1)
+        signature = BITBASE_KQK, first = queens;
+    else if (strong == rooks && __builtin_popcountll(rooks) == 1)
+        signature = BITBASE_KRK, first = rooks;
+    else if (strong == pawns && __builtin_popcountll(pawns) == 1)
+        signature = BITBASE_KPK, first = pawns;
+    else if (strong == (bishops | knights) && __builtin_popcountll(bishops) == 1 && __builtin_popcountll(knights) == 1)
+        signature = BITBASE_KBNK, first = bishops, second = knights;
+    else
+        return 0;
+
+    if (bitbases->bits[signature] == NULL)
+        return 0;
+
+    // black as the strong side is mirrored top to bottom so its pawn runs towards square 0
+    int flip = white_strong ? 0 : 56;
+    BitbasePosition p;
+    p.side = game->is_white_turn == white_strong ? 0 : 1;
+    p.strong_king = Bitboard_to_position(own[KING]) ^ flip;
+    p.weak_king = Bitboard_to_position(board->pieces[!white_strong][KING]) ^ flip;
+    p.piece[0] = Bitboard_to_position(first) ^ flip;
+    p.piece[1] = second ? Bitboard_to_position(second) ^ flip : -1;
+
+    size_t index = encode_position(signatures[signature].num_pieces, &p);
+    if (bit_set(bitbases->bits[signature], index))
+        *result = white_strong ? 1 : -1;
+    else
+        *result = 0;
+    return 1;
+}
+
+// Score of a bitbase win, from white's point of view. On top of the material it rewards
+// driving the lone king to the edge and bringing the kings together, so the search makes progress.
+int bitbase_win_score(const Game *game, int result)
+{
+    int strong = result > 0 ? WHITE : BLACK;
+    int strong_king = Bitboard_to_position(game->board.pieces[strong][KING]);
+    int weak_king = Bitboard_to_position(game->board.pieces[!strong][KING]);
+
+    int weak_file = weak_king % 8, weak_rank = weak_king / 8;
+    int center_distance = max(3 - weak_file, weak_file - 4) + max(3 - weak_rank, weak_rank - 4);
+    int king_distance = max(abs(weak_file - strong_king % 8), abs(weak_rank - strong_king / 8));
+
+    // The king's square table would hold the strong king back home, so only the other pieces count
+    int material = 0;
+    Bitboard pieces = game->board.occupied[strong] & ~game->board.pieces[strong][KING];
+    while (pieces)
+    {
+        int position = get_and_clear_LSB(&pieces);
+        material += piece_value(game->board.squares[position], position);
+    }
+
+    int score = BITBASE_WIN_SCORE + material + 20 * center_distance - 10 * king_distance;
+    return result > 0 ? score : -score;
+}
@@ -0,0 +1,183 @@
+#include "chessEngine.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define BOOK_ENTRY_SIZE 16 // key (8), move (2), weight (2), learn (4), all big-endian
+
+// Opens a Polyglot .bin book. The file is mapped once and shared by every probe.
+OpeningBook *book_open(const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        printf("ERROR: unable to open book %s\n", path);
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < BOOK_ENTRY_SIZE)
+    {
+        printf("ERROR: book %s is empty\n", path);
+        close(fd);
+        return NULL;
+    }
+
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED)
+    {
+        printf("ERROR: unable to map book %s\n", path);
+        close(fd);
+        return NULL;
+    }
+    // lookups are binary searches, don't read ahead
+    madvise(data, st.st_size, MADV_RANDOM);
+
+    OpeningBook *book = (OpeningBook *)malloc(sizeof(OpeningBook));
+    if (book == NULL)
+    {
+        printf("ERROR: Failed to create opening book\n");
+        munmap(data, st.st_size);
+        close(fd);
+        return NULL;
+    }
+
+    book->fd = fd;
+    book->data = (const unsigned char *)data;
+    book->num_entries = st.st_size / BOOK_ENTRY_SIZE;
+    book->max_ply = DEFAULT_BOOK_DEPTH;
+    book->best_move_only = 0;
+    return book;
+}
+
+void book_close(OpeningBook *book)
+{
+    if (book == NULL)
+        return;
+
+    munmap((void *)book->data, book->num_entries * BOOK_ENTRY_SIZE);
+    close(book->fd);
+    free(book);
+}
+
+static uint64_t read_big_endian(const unsigned char *bytes, int length)
+{
+    uint64_t value = 0;
+    for (int i = 0; i < length; i++)
+        value = (value << 8) | bytes[i];
+    return value;
+}
+
+static uint64_t entry_key(const OpeningBook *book, size_t index)
+{
+    return read_big_endian(book->data + index * BOOK_ENTRY_SIZE, 8);
+}
+
+// Converts a Polyglot move (to file/row in bits 0-5, from in bits 6-11, promotion in 12-14)
+// into engine squares. Castling is stored as "king takes own rook".
+static void decode_book_move(const Game *game, int book_move, Move *m)
+{
+    int to_file = book_move & 7;
+    int to_row = (book_move >> 3) & 7;
+    int from_file = (book_move >> 6) & 7;
+    int from_row = (book_move >> 9) & 7;
+    int promotion = (book_move >> 12) & 7;
+
+    int origin = (7 - from_row) * 8 + from_file;
+    char piece = get_piece_at_position(&game->board, origin);
+    if ((piece == 'K' || piece == 'k') && from_file == 4 && from_row == to_row && (to_file == 7 || to_file == 0))
+    {
+        to_file = to_file == 7 ? 6 : 2;
+    }
+
+    m->origin = origin;
+    m->target = (7 - to_row) * 8 + to_file;
+    m->promotion_piece = '.';
+    if (promotion >= 1 && promotion <= 4)
+    {
+        m->promotion_piece = "NBRQ"[promotion - 1];
+        if (!game->is_white_turn)
+            m->promotion_piece = tolower(m->promotion_piece);
+    }
+}
+
+// Looks the position up in the book. Only legal book moves are considered; one is picked
+// either by weight (weighted random) or as the highest weight if best_move_only is set.
+// Returns 1 and fills out if the position is in the book, 0 otherwise.
+int book_probe(const OpeningBook *book, Game *game, Move *out)
+{
+    if (book == NULL)
+        return 0;
+
+    if (game->ply >= book->max_ply)
+        return 0;
+
+    // lower bound binary search on the key
+    uint64_t key = position_key(game);
+    size_t low = 0, high = book->num_entries;
+    while (low < high)
+    {
+        size_t middle = low + (high - low) / 2;
+        if (entry_key(book, middle) < key)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    if (low >= book->num_entries || entry_key(book, low) != key)
+        return 0;
+
+    Move legal[MAX_MOVES];
+    int num_legal = generate_legal_moves(game, game->is_white_turn, legal);
+
+    Move candidates[MAX_MOVES];
+    int weights[MAX_MOVES];
+    int num_candidates = 0;
+    long total_weight = 0;
+
+    for (size_t i = low; i < book->num_entries && entry_key(book, i) == key; i++)
+    {
+        const unsigned char *entry = book->data + i * BOOK_ENTRY_SIZE;
+        int book_move = (int)read_big_endian(entry + 8, 2);
+        int weight = (int)read_big_endian(entry + 10, 2);
+
+        Move m;
+        decode_book_move(game, book_move, &m);
+        for (int j = 0; j < num_legal && num_candidates < MAX_MOVES; j++)
+        {
+            if (legal[j].origin == m.origin && legal[j].target == m.target &&
+                legal[j].promotion_piece == m.promotion_piece)
+            {
+                candidates[num_candidates] = legal[j];
+                weights[num_candidates] = weight;
+                total_weight += weight;
+                num_candidates++;
+                break;
+            }
+        }
+    }
+    if (num_candidates == 0)
+        return 0;
+
+    int chosen = 0;
+    if (book->best_move_only || total_weight == 0)
+    {
+        for (int i = 1; i < num_candidates; i++)
+        {
+            if (weights[i] > weights[chosen])
+                chosen = i;
+        }
+    }
+    else
+    {
+        long pick = rand_r(&game->random_seed) % total_weight;
+        while (pick >= weights[chosen])
+        {
+            pick -= weights[chosen];
+            chosen++;
+        }
+    }
+
+    *out = candidates[chosen];
+    return 1;
+}
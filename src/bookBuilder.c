@@ -0,0 +1,398 @@
+#include "chessEngine.h"
+#include <unistd.h>
+
+// One (position, move) pair with the results scored by the side that played it.
+// Runs on disk hold these records sorted by key and move, duplicates already merged.
+typedef struct
+{
+    uint64_t key;
+    uint16_t move;
+    uint16_t padding;
+    uint32_t wins;
+    uint32_t draws;
+    uint32_t losses;
+} BookRecord;
+
+typedef struct
+{
+    FILE *file;
+    BookRecord current;
+} BookRun;
+
+static int compare_records(const void *a, const void *b)
+{
+    const BookRecord *x = (const BookRecord *)a;
+    const BookRecord *y = (const BookRecord *)b;
+    if (x->key != y->key)
+        return x->key < y->key ? -1 : 1;
+    return (int)x->move - (int)y->move;
+}
+
+// Sorts the buffer and merges records of the same (key, move) in place, returns the new count
+static size_t sort_and_merge(BookRecord *records, size_t count)
+{
+    if (count == 0)
+        return 0;
+
+    qsort(records, count, sizeof(BookRecord), compare_records);
+
+    size_t merged = 0;
+    for (size_t i = 1; i < count; i++)
+    {
+        if (records[i].key == records[merged].key && records[i].move == records[merged].move)
+        {
+            records[merged].wins += records[i].wins;
+            records[merged].draws += records[i].draws;
+            records[merged].losses += records[i].losses;
+        }
+        else
+        {
+            records[++merged] = records[i];
+        }
+    }
+    return merged + 1;
+}
+
+// Anonymous temporary file in tmp_dir, removed as soon as it is closed
+static FILE *create_run_file(const char *tmp_dir)
+{
+    char path[512];
+    snprintf(path, sizeof(path), "%s/makebook-XXXXXX", tmp_dir);
+    int fd = mkstemp(path);
+    if (fd < 0)
+    {
+        printf("ERROR: unable to create a temporary file in %s\n", tmp_dir);
+        return NULL;
+    }
+    unlink(path);
+    return fdopen(fd, "w+b");
+}
+
+// Polyglot move encoding: to file/row in bits 0-5, from in bits 6-11, promotion in 12-14,
+// castling written as the king capturing its own rook
+int book_encode_move(const Game *game, const Move *m)
+{
+    int origin = m->origin;
+    int target = m->target;
+    char piece = get_piece_at_position(&game->board, m->origin);
+
+    int from_file = origin % 8, from_row = 7 - origin / 8;
+    int to_file = target % 8, to_row = 7 - target / 8;
+
+    if ((piece == 'K' || piece == 'k') && abs(to_file - from_file) == 2)
+        to_file = to_file > from_file ? 7 : 0;
+
+    int promotion = 0;
+    switch (toupper(m->promotion_piece))
+    {
+    case 'N':
+        promotion = 1;
+        break;
+    case 'B':
+        promotion = 2;
+        break;
+    case 'R':
+        promotion = 3;
+        break;
+    case 'Q':
+        promotion = 4;
+        break;
+    }
+
+    return to_file | (to_row << 3) | (from_file << 6) | (from_row << 9) | (promotion << 12);
+}
+
+static void write_big_endian(FILE *out, uint64_t value, int length)
+{
+    for (int i = length - 1; i >= 0; i--)
+        fputc((int)((value >> (8 * i)) & 0xff), out);
+}
+
+// Writes the book entries of one position; weights are 2 * wins + draws scaled to 16 bits
+static long write_position(FILE *out, const BookRecord *moves, int count, const BookBuilderOptions *options)
+{
+    uint64_t best = 0;
+    for (int i = 0; i < count; i++)
+    {
+        uint64_t score = 2ULL * moves[i].wins + moves[i].draws;
+        if (score > best)
+            best = score;
+    }
+    if (best == 0)
+        return 0;
+
+    long written = 0;
+    for (int i = 0; i < count; i++)
+    {
+        uint64_t games = (uint64_t)moves[i].wins + moves[i].draws + moves[i].losses;
+        uint64_t score = 2ULL * moves[i].wins + moves[i].draws;
+        uint64_t weight = score * 65535 / best;
+        if (games < (uint64_t)options->min_games || weight == 0)
+            continue;
+
+        write_big_endian(out, moves[i].key, 8);
+        write_big_endian(out, moves[i].move, 2);
+        write_big_endian(out, weight, 2);
+        write_big_endian(out, 0, 4);
+        written++;
+    }
+    return written;
+}
+
+static int read_record(BookRun *run)
+{
+    return fread(&run->current, sizeof(BookRecord), 1, run->file) == 1;
+}
+
+// Restores the min-heap property of runs below index i (ordered by current record)
+static void sift_down(BookRun **heap, int size, int i)
+{
+    while (1)
+    {
+        int smallest = i;
+        int left = 2 * i + 1, right = 2 * i + 2;
+        if (left < size && compare_records(&heap[left]->current, &heap[smallest]->current) < 0)
+            smallest = left;
+        if (right < size && compare_records(&heap[right]->current, &heap[smallest]->current) < 0)
+            smallest = right;
+        if (smallest == i)
+            return;
+        BookRun *temp = heap[i];
+        heap[i] = heap[smallest];
+        heap[smallest] = temp;
+        i = smallest;
+    }
+}
+
+// k-way merge of the sorted runs into the final .bin file. Returns the number of entries
+// written, -1 if the heap can't be allocated or a write failed.
+static long merge_runs(BookRun *runs, int num_runs, FILE *out, const BookBuilderOptions *options)
+{
+    BookRun **heap = (BookRun **)malloc(num_runs * sizeof(BookRun *));
+    if (heap == NULL)
+    {
+        printf("ERROR: Failed to allocate the merge heap of %d runs\n", num_runs);
+        return -1;
+    }
+    int size = 0;
+    for (int i = 0; i < num_runs; i++)
+    {
+        rewind(runs[i].file);
+        if (read_record(&runs[i]))
+            heap[size++] = &runs[i];
+    }
+    for (int i = size / 2 - 1; i >= 0; i--)
+        sift_down(heap, size, i);
+
+    // moves of the position currently being collected
+    BookRecord moves[MAX_MOVES];
+    int num_moves = 0;
+    long written = 0;
+
+    while (size > 0)
+    {
+        BookRecord record = heap[0]->current;
+        if (!read_record(heap[0]))
+            heap[0] = heap[--size];
+        sift_down(heap, size, 0);
+
+        if (num_moves > 0 && moves[num_moves - 1].key == record.key && moves[num_moves - 1].move == record.move)
+        {
+            moves[num_moves - 1].wins += record.wins;
+            moves[num_moves - 1].draws += record.draws;
+            moves[num_moves - 1].losses += record.losses;
+            continue;
+        }
+        if (num_moves > 0 && (moves[0].key != record.key || num_moves == MAX_MOVES))
+        {
+            written += write_position(out, moves, num_moves, options);
+            num_moves = 0;
+        }
+        moves[num_moves++] = record;
+    }
+    written += write_position(out, moves, num_moves, options);
+
+    free(heap);
+    return ferror(out) ? -1 : written;
+}
+
+// Writes count sorted records to a new run file and appends it to runs. Returns 0 on failure.
+static int add_run(BookRun **runs, int *num_runs, const BookRecord *records, size_t count, const char *tmp_dir)
+{
+    FILE *file = create_run_file(tmp_dir);
+    if (file == NULL || fwrite(records, sizeof(BookRecord), count, file) != count)
+    {
+        printf("ERROR: unable to write a sorted run\n");
+        if (file != NULL)
+            fclose(file);
+        return 0;
+    }
+    BookRun *grown = (BookRun *)realloc(*runs, (*num_runs + 1) * sizeof(BookRun));
+    if (grown == NULL)
+    {
+        printf("ERROR: Failed to allocate %d sorted runs\n", *num_runs + 1);
+        fclose(file);
+        return 0;
+    }
+    *runs = grown;
+    (*runs)[(*num_runs)++].file = file;
+    return 1;
+}
+
+// Builds a Polyglot book from PGN files. Positions of the first options->max_ply plies are
+// collected into a bounded buffer, spilled to disk as sorted runs and merged at the end,
+// so the corpus never has to fit in memory. Returns 1 on success.
+int build_book(const char *out_path, char **pgn_paths, int num_paths, const BookBuilderOptions *options)
+{
+    size_t capacity = options->memory / sizeof(BookRecord);
+    if (capacity < 1024)
+        capacity = 1024;
+
+    BookRecord *records = (BookRecord *)malloc(capacity * sizeof(BookRecord));
+    if (records == NULL)
+    {
+        printf("ERROR: Failed to allocate %zu book records\n", capacity);
+        return 0;
+    }
+
+    // A game's records wait here until all its moves have been read, an illegal one rejects the game
+    int max_ply = max(options->max_ply, 1);
+    BookRecord *game_records = (BookRecord *)malloc(max_ply * sizeof(BookRecord));
+    if (game_records == NULL)
+    {
+        printf("ERROR: Failed to allocate %d book records\n", max_ply);
+        free(records);
+        return 0;
+    }
+
+    BookRun *runs = NULL;
+    int num_runs = 0;
+    size_t count = 0;
+    long long games = 0, skipped = 0, positions = 0;
+    long entries = 0;
+    int success = 0;
+    PgnReader *reader = NULL;
+    FILE *out = NULL;
+    clock_t start = clock();
+
+    for (int p = 0; p < num_paths; p++)
+    {
+        reader = pgn_open(pgn_paths[p]);
+        if (reader == NULL)
+            continue;
+
+        PgnGame pgn_game;
+        Game game;
+        while (pgn_next_game(reader, &pgn_game))
+        {
+            // white's score: 2 win, 1 draw, 0 loss
+            int white_result;
+            if (strcmp(pgn_game.tags.result, "1-0") == 0)
+                white_result = 2;
+            else if (strcmp(pgn_game.tags.result, "0-1") == 0)
+                white_result = 0;
+            else if (strcmp(pgn_game.tags.result, "1/2-1/2") == 0)
+                white_result = 1;
+            else
+            {
+                skipped++;
+                continue;
+            }
+            if (!pgn_start_position(&pgn_game, &game))
+            {
+                skipped++;
+                continue;
+            }
+
+            int game_count = 0;
+            int status = 1;
+            for (int ply = 0; ply < options->max_ply; ply++)
+            {
+                uint64_t key = position_key(&game);
+                int white_to_move = game.is_white_turn;
+                Game before = game;
+
+                Move m;
+                status = pgn_next_move(&pgn_game, &game, &m);
+                if (status != 1)
+                    break;
+
+                int result = white_to_move ? white_result : 2 - white_result;
+                BookRecord *record = &game_records[game_count++];
+                record->key = key;
+                record->move = (uint16_t)book_encode_move(&before, &m);
+                record->padding = 0;
+                record->wins = result == 2;
+                record->draws = result == 1;
+                record->losses = result == 0;
+            }
+            if (status < 0)
+            {
+                skipped++;
+                continue;
+            }
+            games++;
+
+            for (int i = 0; i < game_count; i++)
+            {
+                if (count == capacity)
+                {
+                    // spill a sorted run
+                    count = sort_and_merge(records, count);
+                    if (!add_run(&runs, &num_runs, records, count, options->tmp_dir))
+                        goto cleanup;
+                    count = 0;
+                }
+                records[count++] = game_records[i];
+                positions++;
+            }
+        }
+        pgn_close(reader);
+        reader = NULL;
+    }
+
+    // whatever is still buffered becomes the last run
+    count = sort_and_merge(records, count);
+    if (!add_run(&runs, &num_runs, records, count, options->tmp_dir))
+        goto cleanup;
+    free(records);
+    records = NULL;
+
+    out = fopen(out_path, "wb");
+    if (out == NULL)
+    {
+        printf("ERROR: unable to create %s\n", out_path);
+        goto cleanup;
+    }
+    entries = merge_runs(runs, num_runs, out, options);
+    // buffered writes only fail for good at fclose, on a full disk for instance
+    int closed = fclose(out) == 0;
+    out = NULL;
+    if (entries < 0 || !closed)
+    {
+        printf("ERROR: unable to write %s\n", out_path);
+        goto cleanup;
+    }
+    success = 1;
+
+cleanup:
+    if (out != NULL)
+        fclose(out);
+    if (reader != NULL)
+        pgn_close(reader);
+    for (int i = 0; i < num_runs; i++)
+        fclose(runs[i].file);
+    free(runs);
+    free(records);
+    free(game_records);
+    if (!success)
+        return 0;
+
+    double time_spent = (double)(clock() - start) / CLOCKS_PER_SEC;
+    printf("Games:          %lld (%lld skipped)\n", games, skipped);
+    printf("Positions:      %lld\n", positions);
+    printf("Sorted runs:    %d\n", num_runs);
+    printf("Book entries:   %ld\n", entries);
+    printf("Time spent:     %.3f seconds\n", time_spent);
+    return 1;
+}
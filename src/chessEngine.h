@@ -0,0 +1,499 @@
+#ifndef CHESS_ENGINE_H
+#define CHESS_ENGINE_H
+
+// Engine core: board representation, move generation, search and the file formats.
+// No SDL and no global state, everything lives in the structs passed in, so several
+// engines can run side by side in one process. Built as build/libchessengine.a.
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BOARD_SIZE 8
+
+// 64-bit unsigned integer to represent a bitboard
+typedef uint64_t Bitboard;
+
+// Colors and piece types; ChessBoard.pieces is indexed [color][type]
+#define BLACK 0
+#define WHITE 1 // same value as is_white_turn
+#define PAWN 0
+#define KNIGHT 1
+#define BISHOP 2
+#define ROOK 3
+#define QUEEN 4
+#define KING 5
+
+// Piece codes of the mailbox, color * 6 + type: they index ChessBoard.pieces and the
+// evaluation tables without any translation
+#define EMPTY 12
+#define MAKE_PIECE(color, type) ((color) * 6 + (type))
+#define PIECE_COLOR(piece) ((piece) / 6)
+#define PIECE_TYPE(piece) ((piece) % 6)
+
+// Square sets; square 0 is a8 and square 63 is h1, white pawns move towards square 0
+#define FILE_A 0x0101010101010101ULL
+#define FILE_H 0x8080808080808080ULL
+#define RANK_8 0x00000000000000FFULL
+#define RANK_7 0x000000000000FF00ULL // black pawns start here
+#define RANK_2 0x00FF000000000000ULL // white pawns start here
+#define RANK_1 0xFF00000000000000ULL
+
+// Castling rights, in the order of the FEN "KQkq" letters
+#define CASTLE_WHITE_SHORT 1
+#define CASTLE_WHITE_LONG 2
+#define CASTLE_BLACK_SHORT 4
+#define CASTLE_BLACK_LONG 8
+
+// The position itself, 184 bytes so a copy touches three cache lines
+typedef struct
+{
+    Bitboard pieces[2][6]; // [color][type]
+    Bitboard occupied[2];  // all pieces of each color
+    uint8_t squares[64];   // piece code on every square (mailbox), EMPTY if none
+    uint8_t castling;      // CASTLE_* rights still available
+    int8_t en_passant;     // square a pawn can capture en passant on, -1 if none
+} ChessBoard;
+
+// Structure for a single move
+typedef struct Move
+{
+    int origin;           // Origin position (0-63)
+    int target;           // Target position (0-63)
+    char captured;        // Captured piece (or '.' if none)
+    char promotion_piece; // Promotion piece (or '.' if none)
+    struct Move *next;    // Pointer to next move
+    struct Move *prev;    // Pointer to previous move
+} Move;
+
+// Structure for the move list
+typedef struct MoveList
+{
+    Move *head; // First move in the list
+    Move *tail; // Last move in the list
+    int size;   // Number of moves in the list
+} MoveList;
+
+#define MAX_SEARCH_DEPTH 64 // plies
+#define MATE_SCORE 999999 // less the plies from the root to the mate, so shorter mates score higher
+#define MATE_IN_MAX_PLY (MATE_SCORE - MAX_SEARCH_DEPTH) // scores from here on are mates
+#define ASPIRATION_WINDOW 50 // centipawns on each side of the previous iteration's score
+#define MAX_MULTI_PV 8       // root moves a multi-PV search ranks at most
+
+typedef struct
+{
+    int score;                    // Final position score
+    Move moves[MAX_SEARCH_DEPTH]; // Array to store the moves in the line
+    int length;                   // Number of moves in the line
+} SearchResult;
+
+// Transposition table entry, 16 bytes
+#define TT_NONE 0
+#define TT_EXACT 1
+#define TT_LOWER 2 // the score is at least this (beta cutoff)
+#define TT_UPPER 3 // the score is at most this (no move reached alpha)
+typedef struct
+{
+    uint64_t key;  // position_key of the position
+    int32_t score; // white's view, like every search score
+    int8_t depth;  // remaining depth the score was searched with
+    uint8_t bound;
+    uint16_t move; // best move: origin | target << 6 | promotion << 12 (1-4 = n, b, r, q)
+} TTEntry;
+
+typedef struct
+{
+    TTEntry *entries;
+    size_t mask;       // number of entries - 1, a power of two
+    size_t huge_bytes; // how much of the table is backed by huge pages
+} TranspositionTable;
+#define DEFAULT_HASH_SIZE 16 // MB
+
+// Persistent analysis cache file, shared between processes (see analysisCache.c)
+#define DEFAULT_CACHE_DEPTH 5 // shallower searches aren't stored
+#define DEFAULT_CACHE_SIZE 64 // MB, only used when the file is created
+typedef struct
+{
+    int fd;
+    void *mapping;
+    size_t mapping_size;
+    uint64_t *entries;  // buckets of 4 entries, each (key ^ data, data)
+    size_t num_buckets; // a power of two
+    int min_depth;      // shallowest search worth storing
+} AnalysisCache;
+
+// Limits of a single search, 0 means unlimited
+typedef struct
+{
+    int depth;       // plies
+    long long nodes; // positions visited
+    int move_time;   // milliseconds
+} SearchLimits;
+
+// Frontier pruning margins, centipawns per ply of remaining depth (1 or 2); 0 turns a pruning off
+#define DEFAULT_FUTILITY_MARGIN 150
+#define DEFAULT_RAZOR_MARGIN 300
+typedef struct
+{
+    int futility_margin; // quiet moves can't lift the evaluation by more than this
+    int razor_margin;    // further below alpha, only the quiescence search is asked
+} SearchParams;
+
+// Keys of a game's positions, oldest first, so the search sees repetitions of positions played before it
+#define MAX_GAME_PLIES 1024
+typedef struct
+{
+    uint64_t keys[MAX_GAME_PLIES];
+    int count;
+} KeyHistory;
+
+// State of one running search; every thread that searches needs its own
+typedef struct SearchContext
+{
+    SearchLimits limits;
+    SearchParams params;
+    volatile int stop;           // set (also from another thread) to abort the search
+    long long start_time;        // milliseconds, see current_time_ms
+    long long positions_counted; // positions visited so far
+    long long futility_pruned;   // quiet moves left out by futility pruning
+    long long razored;           // nodes that went straight to the quiescence search
+    int depth_reached;           // depth of the last completed iteration
+    int iteration_depth;         // depth of the iteration being searched, bounds the check extension
+    SearchResult best_line;      // score (white's view) and moves of the last completed iteration
+    int multi_pv;                // number of best root moves to find with exact scores, 0 counts as 1
+    SearchResult pv_lines[MAX_MULTI_PV]; // those lines of the last completed iteration, best first
+    int num_pv_lines;
+    TranspositionTable *tt;      // optional, kept between searches by the caller
+    AnalysisCache *cache;        // optional, consulted before and updated after the search
+    const KeyHistory *history;   // optional, the game's positions before the root
+    uint64_t keys[MAX_SEARCH_DEPTH + 1]; // key of the position at each ply of the current line
+    Move killers[MAX_SEARCH_DEPTH][2]; // per ply, the last two quiet moves that caused a beta cutoff
+    void (*on_iteration)(const struct SearchContext *context, void *user_data); // optional progress callback
+    void *user_data;
+} SearchContext;
+
+// Polyglot opening book (.bin), memory-mapped
+#define DEFAULT_BOOK_DEPTH 20 // plies
+typedef struct
+{
+    int fd;
+    const unsigned char *data;
+    size_t num_entries;
+    int max_ply;        // the book is only consulted during the first max_ply plies
+    int best_move_only; // 1: always play the highest weight, 0: weighted random choice
+} OpeningBook;
+
+// Endgame bitbases (king + material against a lone king), memory-mapped
+#define BITBASE_KQK 0
+#define BITBASE_KRK 1
+#define BITBASE_KPK 2
+#define BITBASE_KBNK 3
+#define BITBASE_COUNT 4
+#define BITBASE_WIN_SCORE 50000 // below mate scores, above any normal evaluation
+typedef struct
+{
+    void *mapping[BITBASE_COUNT];
+    size_t mapping_size[BITBASE_COUNT];
+    const uint8_t *bits[BITBASE_COUNT]; // NULL if the table wasn't found
+} Bitbases;
+
+// Settings for building a book from PGN files ("main makebook")
+typedef struct
+{
+    int max_ply;         // only the first max_ply plies of every game are used
+    int min_games;       // moves played fewer times are left out
+    size_t memory;       // bytes of records buffered before a sorted run is spilled to disk
+    const char *tmp_dir; // where the sorted runs are stored
+} BookBuilderOptions;
+
+// One side of an engine match ("main match")
+#define MATCH_MAX_OPTIONS 16
+typedef struct
+{
+    char name[64];
+    char command[256];                    // shell command of an external UCI engine, empty for the built-in engine
+    SearchLimits limits;                  // per move
+    SearchParams params;                  // built-in engine only
+    char options[MATCH_MAX_OPTIONS][128]; // "Name=value", the UCI options of "main uci"
+    int num_options;
+    OpeningBook *book; // built-in engine only, opened from the options
+    Bitbases *bitbases;
+    int hash_size; // MB, every worker has its own table
+} MatchEngine;
+
+typedef struct
+{
+    MatchEngine engines[2];
+    int games;
+    int concurrency;       // games played at the same time
+    const char *openings;  // EPD file or Polyglot .bin book, NULL for the initial position
+    int book_plies;        // length of the random walk through the book for each opening
+    const char *pgn_path;  // finished games are appended here, NULL for none
+    int max_plies;         // longer games are adjudicated as a draw
+    int sprt;              // stop as soon as the SPRT accepts either hypothesis
+    double elo0, elo1;     // SPRT hypotheses H0: elo <= elo0, H1: elo >= elo1
+    double alpha, beta;    // SPRT error probabilities
+    unsigned int seed;     // for the book walks and book moves
+} MatchOptions;
+
+// Budget of the mate solver ("main mate")
+#define DEFAULT_MATE_MEMORY 64 // MB
+typedef struct
+{
+    long long max_nodes; // positions expanded before giving up, 0 for no limit
+    size_t memory_mb;    // size of its table of proof and disproof numbers
+} MateSolverOptions;
+
+// What the mate solver found out
+#define MATE_FOUND 1
+#define MATE_NONE 0     // proven that there is no mate within the moves asked for
+#define MATE_UNKNOWN -1 // the node budget ran out first
+typedef struct
+{
+    int result;
+    int mate_in;                 // moves of the shortest mate, with MATE_FOUND
+    Move line[MAX_SEARCH_DEPTH]; // a mating line: the attacker mates as fast and the defender resists as long as possible
+    int length;
+    long long nodes; // positions expanded
+} MateSolution;
+
+// the structure that holds all the chess game information. The search copies it at every
+// node, so it owns nothing: GUI state and move lists live with the caller.
+typedef struct
+{
+    ChessBoard board;         // game board
+    int is_white_turn;        // 1-white 0-black
+    int isCheck;              // -1: no check, 0: Stalemate, 1: white check, 2: black check, 3: white checkmate, 4: black checkmate, 10: both in check
+    int ply;                  // plies played since the start position, limits book use
+    int halfmove_clock;       // plies since the last capture or pawn move (fifty-move rule)
+    int reversible_plies;     // plies since the last capture, pawn move or castling-rights change
+    OpeningBook *book;        // opening book used by engine_move, NULL if none
+    Bitbases *bitbases;       // endgame bitbases used by the search, NULL if none
+    unsigned int random_seed; // rand_r state for picking book moves
+} Game;
+
+#define MAX_MOVES 256
+
+// Kinds of moves for generate_moves
+#define GEN_ALL 0
+#define GEN_CAPTURES 1 // captures, en passant and promotions
+#define GEN_QUIETS 2   // everything else
+
+// Hands out the moves of one search node lazily and in stages: the transposition table move,
+// captures (most valuable victim first), killer moves, the remaining quiet moves, then the
+// captures that lose material. Later stages are only generated if the earlier moves didn't
+// cause a cutoff (see movePicker.c).
+typedef struct
+{
+    Game *game;
+    int stage;
+    Move hash_move; // origin == target if there is none
+    Move killers[2];
+    int killer_index;
+    Move moves[MAX_MOVES]; // the losing captures, then the captures or quiet moves of the current stage
+    int scores[MAX_MOVES]; // capture ordering
+    int count;
+    int index;
+    int bad_count;  // losing captures at the front of moves
+    int quiescence; // captures only, without the losing ones
+} MovePicker;
+
+#define START_FEN "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
+
+// Seven Tag Roster plus the optional starting position of a PGN game
+typedef struct
+{
+    char event[64];
+    char site[64];
+    char date[16];
+    char round[16];
+    char white[64];
+    char black[64];
+    char result[8];
+    char fen[100]; // empty if the game starts from the initial position
+} PgnTags;
+
+// Memory-mapped PGN file, read one game at a time
+typedef struct
+{
+    int fd;
+    const char *data;
+    size_t size;
+    size_t offset; // start of the next unread game
+} PgnReader;
+
+// A single game inside a PgnReader; the movetext is replayed lazily
+typedef struct
+{
+    PgnTags tags;
+    const char *cursor; // next unread movetext character
+    const char *end;    // end of this game's movetext
+} PgnGame;
+
+// Function prototypes
+
+// game.c
+void print_board(ChessBoard *board);
+void move(Game *game, int start_position, int end_position);
+int handle_promotion(ChessBoard *board, int promotion_tile, char promotion_piece);
+int handle_castling(Game *game, int piece, int start_position, int end_position);
+void toggle_turn(Game *game);
+/*
+Game state values:
+-1: No check/normal play
+ 0: Stalemate
+ 1: White in check
+ 2: Black in check
+ 3: White is checkmated
+ 4: Black is checkmated
+*/
+void check_check(Game *game);
+void check_checkmate(Game *game);
+void play_move(Game *game, int origin, int target, char promotion_piece);
+int castling_rights(const Game *game);
+
+// helperFunctions.c
+void print_bitboard(Bitboard bb);
+MoveList *calculate_all_moves(Game *game, int color);
+int generate_legal_moves(Game *game, int color, Move *moves);
+int generate_moves(Game *game, int color, int kind, int legal_only, Move *moves);
+long long current_time_ms(void);
+int Bitboard_to_position(Bitboard bb);
+Bitboard position_to_Bitboard(int position);
+void position_to_notation(int position, char *notation);
+int get_and_clear_LSB(Bitboard *bb);
+int is_move_legal(Game *game, int start_position, int end_position);
+int has_legal_move(Game *game);
+int max(int a, int b);
+int min(int a, int b);
+void print_piece_values_board(Game *game);
+
+// bitboard.c
+extern const Bitboard knight_attack_table[64];
+extern const Bitboard king_attack_table[64];
+extern const Bitboard pawn_attack_table[2][64]; // [color][square]
+int initialize_board(Game *game);
+char get_piece_at_position(const ChessBoard *board, int position);
+int piece_code(char piece);
+Bitboard *piece_bitboard(ChessBoard *board, char piece);
+void place_piece(ChessBoard *board, int piece, int position);
+Bitboard calculate_threat_map(Game *game, int color);
+Bitboard attackers_to(const ChessBoard *board, int square, int by_color);
+Bitboard all_attackers_to(const ChessBoard *board, int square, Bitboard occupied);
+int is_square_attacked(const ChessBoard *board, int square, int by_color);
+Bitboard checkers(const Game *game);
+
+Bitboard calculate_pawn_moves(Game *game, int start_position, int attacksOnly);
+Bitboard pawn_attacks(Bitboard pawns, int color);
+Bitboard pawn_pushes(Bitboard pawns, int color, Bitboard empty);
+Bitboard pawn_double_pushes(Bitboard pawns, int color, Bitboard empty);
+Bitboard rook_attacks(int square, Bitboard occupied);
+Bitboard bishop_attacks(int square, Bitboard occupied);
+Bitboard calculate_rook_moves(Game *game, int start_position, int include_friendly);
+Bitboard calculate_bishop_moves(Game *game, int start_position, int include_friendly);
+Bitboard calculate_knight_moves(Game *game, int start_position, int include_friendly);
+Bitboard calculate_queen_moves(Game *game, int start_position, int include_friendly);
+Bitboard calculate_king_moves(Game *game, int start_position);
+
+// moveList.c
+MoveList *createMoveList();
+void free_move_list(MoveList *list);
+int addMove(MoveList *list, int origin, int target, char captured, char promotion_piece);
+Move *removeLastMove(MoveList *list);
+void printMoves(MoveList *list);
+void clearMoveList(MoveList *list);
+
+// chessEngine.c
+extern const int piece_values[6]; // material by piece type
+int engine_move(Game *game, KeyHistory *history, Move *played);
+int evaluate_board(Game *game);
+int piece_value(int piece, int position);
+int search_position(Game *game, SearchContext *context, Move *best_move);
+SearchResult minimax(Game *game, int depth, int ply, int alpha, int beta, SearchContext *context);
+
+// fen.c
+int load_fen(Game *game, const char *fen);
+void write_fen(const Game *game, char *fen);
+
+// uci.c
+void move_to_uci(const Move *m, char *text);
+int parse_uci_move(Game *game, const char *text, Move *out);
+void format_uci_score(const Game *game, const SearchResult *line, char *text);
+int uci_loop(void);
+
+// commands.c
+int run_command(int argc, char *argv[]);
+
+// match.c
+int run_match(MatchOptions *options);
+
+// mateSolver.c
+int solve_mate(Game *game, int max_moves, const MateSolverOptions *options, MateSolution *solution);
+
+// serve.c
+int run_server(const char *socket_path, int num_workers, int hash_size, AnalysisCache *cache);
+
+// pgn.c
+PgnReader *pgn_open(const char *path);
+void pgn_close(PgnReader *reader);
+int pgn_next_game(PgnReader *reader, PgnGame *pgn_game);
+int pgn_start_position(const PgnGame *pgn_game, Game *game);
+int pgn_next_move(PgnGame *pgn_game, Game *game, Move *played);
+int move_to_san(Game *game, const Move *m, char *san);
+const char *pgn_result(const Game *game);
+int pgn_write_game(FILE *out, const Game *start, const MoveList *moves, const PgnTags *tags);
+
+// zobrist.c
+uint64_t position_key(const Game *game);
+void key_history_push(KeyHistory *history, const Game *game);
+
+// movePicker.c
+void move_picker_init(MovePicker *picker, Game *game, const TTEntry *entry, const Move killers[2]);
+void move_picker_init_quiescence(MovePicker *picker, Game *game);
+int move_picker_next(MovePicker *picker, Move *m);
+int is_quiet_move(const Game *game, const Move *m);
+int same_move(const Move *a, const Move *b);
+
+// see.c
+int see(const ChessBoard *board, const Move *m);
+
+// hugePages.c
+void *large_alloc(size_t size, size_t *huge_bytes);
+void large_free(void *memory, size_t size);
+
+// transposition.c
+TranspositionTable *tt_create(size_t size_mb);
+void tt_free(TranspositionTable *tt);
+void tt_clear(TranspositionTable *tt);
+const TTEntry *tt_probe(const TranspositionTable *tt, uint64_t key);
+void tt_store(TranspositionTable *tt, uint64_t key, int depth, int score, int bound, const Move *best_move);
+int tt_order_move(const TTEntry *entry, Move *moves, int count);
+int tt_decode_move(const TTEntry *entry, const Game *game, Move *m);
+uint16_t tt_encode_move(const Move *m);
+
+// analysisCache.c
+AnalysisCache *analysis_cache_open(const char *path, size_t size_mb);
+void analysis_cache_close(AnalysisCache *cache);
+int analysis_cache_probe(const AnalysisCache *cache, uint64_t key, TTEntry *out);
+void analysis_cache_store(AnalysisCache *cache, uint64_t key, int depth, int score, int bound, const Move *best_move);
+
+// book.c
+OpeningBook *book_open(const char *path);
+void book_close(OpeningBook *book);
+int book_probe(const OpeningBook *book, Game *game, Move *out);
+
+// bookBuilder.c
+int book_encode_move(const Game *game, const Move *m);
+int build_book(const char *out_path, char **pgn_paths, int num_paths, const BookBuilderOptions *options);
+
+// bitbase.c
+int generate_bitbases(const char *dir, int num_threads);
+Bitbases *bitbases_open(const char *dir);
+void bitbases_close(Bitbases *bitbases);
+int bitbase_probe(const Bitbases *bitbases, const Game *game, int *result);
+int bitbase_win_score(const Game *game, int result);
+
+#endif // CHESS_ENGINE_H
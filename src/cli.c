@@ -0,0 +1,15 @@
+#include "chessEngine.h"
+
+// The command line tools without the GUI, so they build and run where SDL is missing
+// compile with         "make cli"
+// replay a PGN file    "./build/chessengine pgn games.pgn"
+// build a book         "./build/chessengine makebook book.bin games.pgn [--plies 20] [--min-games 1] [--memory 256]"
+// endgame bitbases     "./build/chessengine bitbase [--dir bitbases] [--threads N]"
+// UCI engine           "./build/chessengine uci"
+// analysis daemon      "./build/chessengine serve --socket /tmp/chess.sock [--workers N] [--hash MB]"
+// mate-in-N solver     "./build/chessengine mate \"<fen>\" 5 [--nodes N] [--memory MB]"
+// engine match         "./build/chessengine match --engine name=new depth=5 --engine name=old depth=4 --games 1000 --openings book.bin"
+int main(int argc, char *argv[])
+{
+    return run_command(argc, argv);
+}
@@ -0,0 +1,401 @@
+#include "chessEngine.h"
+#include <sys/stat.h>
+#include <unistd.h>
+
+// The command line tools. They need no SDL, so both ./build/main and the headless
+// ./build/chessengine run them through run_command.
+
+// "main pgn <file>": replays every game of a PGN file through the move generator
+static int replay_pgn(int argc, char *argv[])
+{
+    if (argc < 3)
+    {
+        printf("usage: %s pgn <file.pgn>\n", argv[0]);
+        return 0;
+    }
+
+    PgnReader *reader = pgn_open(argv[2]);
+    if (reader == NULL)
+    {
+        return 0;
+    }
+
+    clock_t start = clock();
+    long long games = 0, plies = 0, errors = 0;
+    PgnGame pgn_game;
+    Game game;
+
+    while (pgn_next_game(reader, &pgn_game))
+    {
+        games++;
+        if (!pgn_start_position(&pgn_game, &game))
+        {
+            printf("ERROR: game %lld has an invalid FEN tag\n", games);
+            errors++;
+            continue;
+        }
+
+        int status;
+        int ply = 0;
+        while ((status = pgn_next_move(&pgn_game, &game, NULL)) == 1)
+        {
+            ply++;
+        }
+        plies += ply;
+        if (status < 0)
+        {
+            printf("ERROR: game %lld has an illegal or unreadable move after ply %d\n", games, ply);
+            errors++;
+        }
+    }
+    pgn_close(reader);
+
+    double time_spent = (double)(clock() - start) / CLOCKS_PER_SEC;
+    printf("Games:          %lld\n", games);
+    printf("Plies:          %lld\n", plies);
+    printf("Errors:         %lld\n", errors);
+    printf("Time spent:     %.3f seconds\n", time_spent);
+    if (time_spent > 0)
+    {
+        printf("Speed:          %.0f games/minute\n", games * 60.0 / time_spent);
+    }
+    return errors == 0;
+}
+
+// "main makebook <out.bin> <games.pgn>... [--plies N] [--min-games N] [--memory MB] [--tmp dir]"
+static int make_book(int argc, char *argv[])
+{
+    BookBuilderOptions options;
+    options.max_ply = DEFAULT_BOOK_DEPTH;
+    options.min_games = 1;
+    options.memory = 256 * 1024 * 1024;
+    options.tmp_dir = getenv("TMPDIR") != NULL ? getenv("TMPDIR") : "/tmp";
+
+    const char *out_path = NULL;
+    char **pgn_paths = (char **)malloc(argc * sizeof(char *));
+    int num_paths = 0;
+
+    for (int i = 2; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--plies") == 0 && i + 1 < argc)
+            options.max_ply = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--min-games") == 0 && i + 1 < argc)
+            options.min_games = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--memory") == 0 && i + 1 < argc)
+            options.memory = (size_t)atol(argv[++i]) * 1024 * 1024;
+        else if (strcmp(argv[i], "--tmp") == 0 && i + 1 < argc)
+            options.tmp_dir = argv[++i];
+        else if (out_path == NULL)
+            out_path = argv[i];
+        else
+            pgn_paths[num_paths++] = argv[i];
+    }
+
+    if (out_path == NULL || num_paths == 0)
+    {
+        printf("usage: %s makebook <out.bin> <games.pgn>... [--plies N] [--min-games N] [--memory MB] [--tmp dir]\n", argv[0]);
+        free(pgn_paths);
+        return 0;
+    }
+
+    int success = build_book(out_path, pgn_paths, num_paths, &options);
+    free(pgn_paths);
+    return success;
+}
+
+// "main bitbase [--dir bitbases] [--threads N]": generates the endgame bitbases
+static int make_bitbases(int argc, char *argv[])
+{
+    const char *dir = "bitbases";
+    int num_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+    for (int i = 2; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--dir") == 0 && i + 1 < argc)
+            dir = argv[++i];
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            num_threads = atoi(argv[++i]);
+    }
+
+    mkdir(dir, 0755);
+    clock_t start = clock();
+    int success = generate_bitbases(dir, num_threads);
+    printf("Time spent:     %.3f seconds (CPU)\n", (double)(clock() - start) / CLOCKS_PER_SEC);
+    return success;
+}
+
+// "main uci": play through the Universal Chess Interface on stdin/stdout
+static int run_uci(void)
+{
+    return uci_loop();
+}
+
+// Reads the "key=value" words following --engine: name=, cmd=, depth=, nodes=, movetime= or option.Name=value
+static int parse_match_engine(MatchEngine *engine, int argc, char *argv[], int i)
+{
+    for (; i < argc && strncmp(argv[i], "--", 2) != 0; i++)
+    {
+        const char *value = strchr(argv[i], '=');
+        if (value == NULL)
+        {
+            printf("ERROR: expected key=value after --engine, got %s\n", argv[i]);
+            return -1;
+        }
+        value++;
+
+        if (strncmp(argv[i], "name=", 5) == 0)
+            snprintf(engine->name, sizeof(engine->name), "%s", value);
+        else if (strncmp(argv[i], "cmd=", 4) == 0)
+            snprintf(engine->command, sizeof(engine->command), "%s", value);
+        else if (strncmp(argv[i], "depth=", 6) == 0)
+            engine->limits.depth = atoi(value);
+        else if (strncmp(argv[i], "nodes=", 6) == 0)
+            engine->limits.nodes = atoll(value);
+        else if (strncmp(argv[i], "movetime=", 9) == 0)
+            engine->limits.move_time = atoi(value);
+        else if (strncmp(argv[i], "option.", 7) == 0 && engine->num_options < MATCH_MAX_OPTIONS)
+            snprintf(engine->options[engine->num_options++], sizeof(engine->options[0]), "%s", argv[i] + 7);
+        else
+        {
+            printf("ERROR: unknown engine setting %s\n", argv[i]);
+            return -1;
+        }
+    }
+    return i - 1;
+}
+
+// "main match --engine key=value... --engine key=value... [--games N] [--concurrency N]
+//  [--openings file.epd|book.bin] [--book-plies N] [--depth N | --nodes N | --movetime ms]
+//  [--pgn file] [--max-plies N] [--sprt elo0 elo1] [--alpha a] [--beta b] [--seed N]"
+static int play_match(int argc, char *argv[])
+{
+    MatchOptions options;
+    memset(&options, 0, sizeof(MatchOptions));
+    options.games = 100;
+    options.concurrency = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    options.book_plies = 8;
+    options.max_plies = 400;
+    options.alpha = 0.05;
+    options.beta = 0.05;
+    options.seed = (unsigned int)time(NULL);
+
+    SearchLimits limits = {4, 0, 0}; // same strength as the GUI unless told otherwise
+    int num_engines = 0;
+
+    for (int i = 2; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--engine") == 0 && num_engines < 2)
+        {
+            MatchEngine *engine = &options.engines[num_engines];
+            snprintf(engine->name, sizeof(engine->name), "engine%d", num_engines + 1);
+            engine->hash_size = DEFAULT_HASH_SIZE;
+            engine->params.futility_margin = DEFAULT_FUTILITY_MARGIN;
+            engine->params.razor_margin = DEFAULT_RAZOR_MARGIN;
+            i = parse_match_engine(engine, argc, argv, i + 1);
+            if (i < 0)
+                return 0;
+            num_engines++;
+        }
+        else if (strcmp(argv[i], "--games") == 0 && i + 1 < argc)
+            options.games = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--concurrency") == 0 && i + 1 < argc)
+            options.concurrency = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--openings") == 0 && i + 1 < argc)
+            options.openings = argv[++i];
+        else if (strcmp(argv[i], "--book-plies") == 0 && i + 1 < argc)
+            options.book_plies = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--depth") == 0 && i + 1 < argc)
+            limits = (SearchLimits){atoi(argv[++i]), 0, 0};
+        else if (strcmp(argv[i], "--nodes") == 0 && i + 1 < argc)
+            limits = (SearchLimits){0, atoll(argv[++i]), 0};
+        else if (strcmp(argv[i], "--movetime") == 0 && i + 1 < argc)
+            limits = (SearchLimits){0, 0, atoi(argv[++i])};
+        else if (strcmp(argv[i], "--pgn") == 0 && i + 1 < argc)
+            options.pgn_path = argv[++i];
+        else if (strcmp(argv[i], "--max-plies") == 0 && i + 1 < argc)
+            options.max_plies = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--sprt") == 0 && i + 2 < argc)
+        {
+            options.sprt = 1;
+            options.elo0 = atof(argv[++i]);
+            options.elo1 = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--alpha") == 0 && i + 1 < argc)
+            options.alpha = atof(argv[++i]);
+        else if (strcmp(argv[i], "--beta") == 0 && i + 1 < argc)
+            options.beta = atof(argv[++i]);
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+            options.seed = (unsigned int)atol(argv[++i]);
+        else
+        {
+            printf("ERROR: unknown match option %s\n", argv[i]);
+            return 0;
+        }
+    }
+
+    if (num_engines != 2 || options.games < 1 || options.concurrency < 1 || options.max_plies < 1)
+    {
+        printf("usage: %s match --engine name=A [cmd=\"./main uci\"] [depth=N|nodes=N|movetime=ms] [option.Name=value]...\n"
+               "                 --engine name=B ... [--games N] [--concurrency N] [--openings file.epd|book.bin]\n"
+               "                 [--book-plies N] [--depth N|--nodes N|--movetime ms] [--pgn file] [--max-plies N]\n"
+               "                 [--sprt elo0 elo1] [--alpha a] [--beta b] [--seed N]\n",
+               argv[0]);
+        return 0;
+    }
+
+    // engines without their own limits use the common ones
+    for (int i = 0; i < 2; i++)
+    {
+        SearchLimits *own = &options.engines[i].limits;
+        if (own->depth == 0 && own->nodes == 0 && own->move_time == 0)
+            *own = limits;
+    }
+
+    return run_match(&options);
+}
+
+// "main serve --socket path [--workers N] [--hash MB] [--cache file] [--cache-size MB] [--cache-depth N]":
+// analysis daemon, see serve.c for the protocol
+static int run_daemon(int argc, char *argv[])
+{
+    const char *socket_path = NULL;
+    int num_workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int hash_size = DEFAULT_HASH_SIZE;
+    const char *cache_path = NULL;
+    int cache_size = DEFAULT_CACHE_SIZE;
+    int cache_depth = DEFAULT_CACHE_DEPTH;
+
+    for (int i = 2; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--socket") == 0 && i + 1 < argc)
+            socket_path = argv[++i];
+        else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc)
+            num_workers = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--hash") == 0 && i + 1 < argc)
+            hash_size = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc)
+            cache_path = argv[++i];
+        else if (strcmp(argv[i], "--cache-size") == 0 && i + 1 < argc)
+            cache_size = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--cache-depth") == 0 && i + 1 < argc)
+            cache_depth = atoi(argv[++i]);
+    }
+
+    if (socket_path == NULL || num_workers < 1 || hash_size < 1 || cache_size < 1)
+    {
+        printf("usage: %s serve --socket <path> [--workers N] [--hash MB] [--cache file] [--cache-size MB] [--cache-depth N]\n", argv[0]);
+        return 0;
+    }
+
+    AnalysisCache *cache = NULL;
+    if (cache_path != NULL)
+    {
+        cache = analysis_cache_open(cache_path, cache_size);
+        if (cache == NULL)
+            return 0;
+        cache->min_depth = cache_depth;
+    }
+
+    int success = run_server(socket_path, num_workers, hash_size, cache);
+    analysis_cache_close(cache);
+    return success;
+}
+
+// "main mate <fen> <N> [--nodes N] [--memory MB]": proves or refutes a mate in N moves
+static int find_mate(int argc, char *argv[])
+{
+    MateSolverOptions options;
+    options.max_nodes = 0;
+    options.memory_mb = DEFAULT_MATE_MEMORY;
+
+    const char *fen = NULL;
+    int max_moves = 0;
+    for (int i = 2; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--nodes") == 0 && i + 1 < argc)
+            options.max_nodes = atoll(argv[++i]);
+        else if (strcmp(argv[i], "--memory") == 0 && i + 1 < argc)
+            options.memory_mb = (size_t)atol(argv[++i]);
+        else if (fen == NULL)
+            fen = argv[i];
+        else
+            max_moves = atoi(argv[i]);
+    }
+
+    if (fen == NULL || max_moves < 1 || options.memory_mb < 1)
+    {
+        printf("usage: %s mate \"<fen>\" <N> [--nodes N] [--memory MB]\n", argv[0]);
+        return 0;
+    }
+
+    Game game;
+    memset(&game, 0, sizeof(Game));
+    if (!load_fen(&game, fen))
+    {
+        printf("ERROR: invalid FEN %s\n", fen);
+        return 0;
+    }
+
+    long long start = current_time_ms();
+    MateSolution solution;
+    if (!solve_mate(&game, max_moves, &options, &solution))
+    {
+        return 0;
+    }
+    double time_spent = (current_time_ms() - start) / 1000.0;
+
+    if (solution.result == MATE_FOUND)
+    {
+        printf("Mate in %d:", solution.mate_in);
+        for (int i = 0; i < solution.length; i++)
+        {
+            char san[16];
+            move_to_san(&game, &solution.line[i], san);
+            printf(" %s", san);
+            play_move(&game, solution.line[i].origin, solution.line[i].target, solution.line[i].promotion_piece);
+        }
+        printf("\n");
+    }
+    else if (solution.result == MATE_NONE)
+    {
+        printf("No mate in %d\n", max_moves);
+    }
+    else
+    {
+        printf("Unknown: the node budget ran out before a mate in %d was proven or refuted\n", max_moves);
+    }
+    printf("Nodes:          %lld\n", solution.nodes);
+    printf("Time spent:     %.3f seconds\n", time_spent);
+    if (time_spent > 0)
+    {
+        printf("Speed:          %.0f nodes/second\n", solution.nodes / time_spent);
+    }
+    return solution.result != MATE_UNKNOWN;
+}
+
+// Runs the tool named by argv[1] with its arguments. Returns the process exit code.
+int run_command(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        printf("usage: %s pgn|makebook|bitbase|uci|match|serve|mate ...\n", argv[0]);
+        return 1;
+    }
+    if (strcmp(argv[1], "pgn") == 0)
+        return replay_pgn(argc, argv) ? 0 : 1;
+    if (strcmp(argv[1], "makebook") == 0)
+        return make_book(argc, argv) ? 0 : 1;
+    if (strcmp(argv[1], "bitbase") == 0)
+        return make_bitbases(argc, argv) ? 0 : 1;
+    if (strcmp(argv[1], "uci") == 0)
+        return run_uci() ? 0 : 1;
+    if (strcmp(argv[1], "match") == 0)
+        return play_match(argc, argv) ? 0 : 1;
+    if (strcmp(argv[1], "serve") == 0)
+        return run_daemon(argc, argv) ? 0 : 1;
+    if (strcmp(argv[1], "mate") == 0)
+        return find_mate(argc, argv) ? 0 : 1;
+
+    printf("ERROR: unknown command %s (pgn, makebook, bitbase, uci, match, serve or mate)\n", argv[1]);
+    return 1;
+}
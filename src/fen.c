@@ -0,0 +1,154 @@
+#include "chessEngine.h"
+
+// Loads a position given in Forsyth-Edwards Notation.
+// Returns 1 on success, 0 if the FEN could not be parsed.
+int load_fen(Game *game, const char *fen)
+{
+    if (game == NULL || fen == NULL)
+    {
+        printf("ERROR: load_fen - invalid parameters\n");
+        return 0;
+    }
+
+    ChessBoard *board = &game->board;
+    memset(board, 0, sizeof(ChessBoard));
+    memset(board->squares, EMPTY, sizeof(board->squares));
+
+    // Piece placement, rank 8 first (square 0 = a8)
+    const char *c = fen;
+    while (*c == ' ')
+        c++;
+
+    int position = 0;
+    for (; *c != '\0' && *c != ' '; c++)
+    {
+        if (*c == '/')
+        {
+            if (position % 8 != 0)
+                return 0;
+            continue;
+        }
+        if (*c >= '1' && *c <= '8')
+        {
+            position += *c - '0';
+            continue;
+        }
+
+        int piece = piece_code(*c);
+        if (piece == EMPTY || position >= 64)
+            return 0;
+        place_piece(board, piece, position);
+        position++;
+    }
+    if (position != 64 || board->pieces[WHITE][KING] == 0 || board->pieces[BLACK][KING] == 0)
+        return 0;
+
+    // Side to move
+    while (*c == ' ')
+        c++;
+    game->is_white_turn = (*c == 'b') ? 0 : 1;
+    if (*c != '\0')
+        c++;
+
+    // Castling rights, only kept if the king and rook are still on their squares
+    while (*c == ' ')
+        c++;
+    board->castling = 0;
+    for (; *c != '\0' && *c != ' '; c++)
+    {
+        const char *letter = strchr("KQkq", *c);
+        if (letter != NULL)
+            board->castling |= 1 << (letter - "KQkq");
+    }
+    const Bitboard castling_squares[4] = {
+        position_to_Bitboard(60) | position_to_Bitboard(63), position_to_Bitboard(60) | position_to_Bitboard(56),
+        position_to_Bitboard(4) | position_to_Bitboard(7), position_to_Bitboard(4) | position_to_Bitboard(0)};
+    for (int i = 0; i < 4; i++)
+    {
+        int color = i < 2 ? WHITE : BLACK;
+        Bitboard king_and_rook = board->pieces[color][KING] | board->pieces[color][ROOK];
+        if ((king_and_rook & castling_squares[i]) != castling_squares[i])
+            board->castling &= ~(1 << i);
+    }
+
+    // En passant target square
+    while (*c == ' ')
+        c++;
+    board->en_passant = -1;
+    if (c[0] >= 'a' && c[0] <= 'h' && (c[1] == '3' || c[1] == '6'))
+    {
+        board->en_passant = (8 - (c[1] - '0')) * 8 + (c[0] - 'a');
+    }
+
+    // Halfmove clock, 0 if the FEN leaves it out; the fullmove number isn't kept
+    while (*c != '\0' && *c != ' ')
+        c++;
+    game->halfmove_clock = (int)strtol(c, NULL, 10);
+    if (game->halfmove_clock < 0)
+        game->halfmove_clock = 0;
+    game->reversible_plies = game->halfmove_clock;
+
+    game->ply = 0;
+    game->isCheck = -1;
+    check_check(game);
+    return 1;
+}
+
+// Writes the position as FEN into fen (at least 100 bytes). The engine doesn't keep
+// the fullmove number, so it is always 1.
+void write_fen(const Game *game, char *fen)
+{
+    const ChessBoard *board = &game->board;
+    char *c = fen;
+
+    // Piece placement, rank 8 first
+    for (int row = 0; row < 8; row++)
+    {
+        int empty = 0;
+        for (int column = 0; column < 8; column++)
+        {
+            char piece = get_piece_at_position(board, row * 8 + column);
+            if (piece == '.')
+            {
+                empty++;
+                continue;
+            }
+            if (empty > 0)
+                *c++ = '0' + empty;
+            empty = 0;
+            *c++ = piece;
+        }
+        if (empty > 0)
+            *c++ = '0' + empty;
+        if (row < 7)
+            *c++ = '/';
+    }
+
+    *c++ = ' ';
+    *c++ = game->is_white_turn ? 'w' : 'b';
+    *c++ = ' ';
+
+    int rights = castling_rights(game);
+    const char castling[] = "KQkq";
+    for (int i = 0; i < 4; i++)
+    {
+        if (rights & (1 << i))
+            *c++ = castling[i];
+    }
+    if (rights == 0)
+        *c++ = '-';
+    *c++ = ' ';
+
+    if (board->en_passant >= 0)
+    {
+        int ep_square = board->en_passant;
+        *c++ = 'a' + ep_square % 8;
+        *c++ = '0' + 8 - ep_square / 8;
+    }
+    else
+    {
+        *c++ = '-';
+    }
+
+    sprintf(c, " %d 1", game->halfmove_clock);
+}
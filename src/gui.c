@@ -1,19 +1,115 @@
 #include "a_header.h"
 
-int runMainMenu(SDL_Window **window, Game **game)
+// Creates the GUI state around an empty game
+GuiState *initGuiState()
 {
-    if (*game == NULL)
+    GuiState *gui = (GuiState *)calloc(1, sizeof(GuiState));
+    if (gui == NULL)
     {
-        *game = (Game *)malloc(sizeof(Game));
-        if (*game == NULL)
+        printf("ERROR: Failed to create game\n");
+        return NULL;
+    }
+    gui->move_history = createMoveList();
+    gui->possible_moves = createMoveList();
+    gui->numPlayer = -1;
+    gui->selected_position = -1;
+    gui->promotion_tile = -1;
+
+    gui->human_color = -1;
+    gui->game.isCheck = 0;
+    gui->game.is_white_turn = 1;
+    gui->game.book = NULL;
+    gui->game.bitbases = NULL;
+    gui->game.random_seed = (unsigned int)time(NULL);
+
+    return gui;
+}
+
+// The engine's board always has a8 at square 0; the GUI turns it around when the human plays
+// black. Maps a board square to its screen tile (0 top left) and back again.
+int screenSquare(const GuiState *gui, int square)
+{
+    return gui->human_color == 0 ? 63 - square : square;
+}
+
+// Marks the squares the selected piece can move to, and those of them the opponent attacks
+void calcReachablePositions(GuiState *gui)
+{
+    int start_position = gui->selected_position;
+
+    gui->reachable_positions = 0;
+    gui->threatened_positions = 0;
+
+    if (gui->possible_moves == NULL)
+    {
+        printf("Error: possible_moves is NULL\n");
+        return;
+    }
+
+    if (gui->possible_moves->head == NULL)
+    {
+        printf("Error: possible_moves->head is NULL\n");
+        return;
+    }
+
+    Move *current_move = gui->possible_moves->head;
+    while (current_move != NULL)
+    {
+        if (current_move->origin == start_position)
         {
-            printf("ERROR: Failed to allocate memory for game\n");
-            return 0;
+            gui->reachable_positions |= position_to_Bitboard(current_move->target);
         }
+        current_move = current_move->next;
+    }
+
+    // The piece is lifted off the board first, so sliders attack through the square it leaves
+    Game lifted;
+    memcpy(&lifted, &gui->game, sizeof(Game));
+    int piece = lifted.board.squares[start_position];
+    if (piece != EMPTY)
+    {
+        Bitboard bb = position_to_Bitboard(start_position);
+        lifted.board.pieces[PIECE_COLOR(piece)][PIECE_TYPE(piece)] &= ~bb;
+        lifted.board.occupied[PIECE_COLOR(piece)] &= ~bb;
+    }
+    gui->threatened_positions = gui->reachable_positions & calculate_threat_map(&lifted, !lifted.is_white_turn);
+}
+
+// Ranks the best moves for the side to move with a short multi-PV search
+void calcSuggestions(GuiState *gui)
+{
+    const int SEARCH_DEPTH = 3; // plies, kept low so the board stays responsive
+
+    gui->num_suggestions = 0;
+    if (!has_legal_move(&gui->game))
+    {
+        return;
+    }
+
+    SearchContext context;
+    memset(&context, 0, sizeof(SearchContext));
+    context.limits.depth = SEARCH_DEPTH;
+    context.params.futility_margin = DEFAULT_FUTILITY_MARGIN;
+    context.params.razor_margin = DEFAULT_RAZOR_MARGIN;
+    context.history = &gui->key_history;
+    context.multi_pv = GUI_SUGGESTIONS;
+
+    Move best_move;
+    if (!search_position(&gui->game, &context, &best_move))
+    {
+        return;
     }
 
+    for (int i = 0; i < context.num_pv_lines && context.pv_lines[i].length > 0; i++)
+    {
+        gui->suggestions[gui->num_suggestions++] = context.pv_lines[i].moves[0];
+    }
+}
+
+int runMainMenu(SDL_Window **window, GuiState *gui)
+{
     // check for correct input
-    if (window == NULL)
+    if (window == NULL || gui == NULL)
     {
         printf("ERROR: runMainMenu - window is NULL\n");
         SDL_Quit();
@@ -122,8 +218,8 @@ int runMainMenu(SDL_Window **window, Game **game)
                 {
                     if (isMouseOverButton(startButton, mouseX, mouseY))
                     {
-                        (*game)->numPlayer = numPlayers;
-                        (*game)->human_color = isWhiteColor;
+                        gui->numPlayer = numPlayers;
+                        gui->human_color = isWhiteColor;
                         return 2;
                     }
                     else if (isMouseOverButton(modeButton, mouseX, mouseY))
@@ -157,15 +253,16 @@ int runMainMenu(SDL_Window **window, Game **game)
     return 0;
 }
 
-int runGameWindow(SDL_Window **window, Game **game)
+int runGameWindow(SDL_Window **window, GuiState *gui)
 {
     // Check for correct input
-    if (window == NULL || game == NULL)
+    if (window == NULL || gui == NULL)
     {
         printf("ERROR: runGameWindow - invalid parameters\n");
         SDL_Quit();
         return 0;
     }
+    Game *game = &gui->game;
 
     // Load font
     TTF_Font *font = TTF_OpenFont("assets/a_font/Aceh-Medium.ttf", 24);
@@ -204,15 +301,23 @@ int runGameWindow(SDL_Window **window, Game **game)
 
     Button *resetButton = createButton(
         BOARD_WIDTH + ((WINDOW_WIDTH - BOARD_WIDTH) / 2) - 100, // Center in white strip
-        100,
+        85,
         "Reset",
         NULL);
 
+    Button *saveButton = createButton(
+        BOARD_WIDTH + ((WINDOW_WIDTH - BOARD_WIDTH) / 2) - 100, // Center in white strip
+        145,
+        "Save PGN",
+        NULL);
+
     // Define colors
     SDL_Color light_square = {238, 216, 192, 255};
     SDL_Color dark_square = {165, 117, 80, 255};
     SDL_Color highlight = {255, 234, 0, 150};
     SDL_Color move_indicator = {0, 87, 183, 150};
+    SDL_Color threatened_indicator = {200, 30, 30, 150}; // moves onto a square the opponent attacks
+    SDL_Color suggestion = {46, 139, 87, 255};
     SDL_Color textColor = {0, 0, 0, 255};
 
     // event handling loop
@@ -235,12 +340,20 @@ int runGameWindow(SDL_Window **window, Game **game)
     {
         if (moves_calulated == 0)
         {
-            (*game)->board.reachable_positions = 0;
-            clearMoveList((*game)->possible_moves);
-            (*game)->possible_moves = calculate_all_moves(*game, (*game)->is_white_turn);
-            check_check(*game); // check for checkmate, stalemate, etc.
-            check_checkmate(*game);
+            gui->reachable_positions = 0;
+    gui->threatened_positions = 0;
+            clearMoveList(gui->possible_moves);
+            gui->possible_moves = calculate_all_moves(game, game->is_white_turn);
+            check_check(game); // check for checkmate, stalemate, etc.
+            check_checkmate(game);
             moves_calulated = 1;
+
+            // Suggest moves whenever a human is to move
+            gui->num_suggestions = 0;
+            if (gui->numPlayer == 2 || gui->human_color == game->is_white_turn)
+            {
+                calcSuggestions(gui);
+            }
         }
 
         // Clear screen with white background
@@ -263,12 +376,13 @@ int runGameWindow(SDL_Window **window, Game **game)
         }
 
         // Second pass: Draw highlight
-        if ((*game)->selected_position != -1)
+        if (gui->selected_position != -1)
         {
             SDL_SetRenderDrawBlendMode(rend, SDL_BLENDMODE_BLEND);
             SDL_SetRenderDrawColor(rend, highlight.r, highlight.g, highlight.b, highlight.a);
-            int row = (*game)->selected_position / 8;
-            int col = (*game)->selected_position % 8;
+            int tile = screenSquare(gui, gui->selected_position);
+            int row = tile / 8;
+            int col = tile % 8;
             SDL_Rect highlight_square = {col * SQUARE_SIZE, row * SQUARE_SIZE, SQUARE_SIZE, SQUARE_SIZE};
             SDL_RenderFillRect(rend, &highlight_square);
         }
@@ -278,52 +392,11 @@ int runGameWindow(SDL_Window **window, Game **game)
         {
             for (int x = 0; x < BOARD_SIZE; x++)
             {
-                char piece = get_piece_at_position(&(*game)->board, y * 8 + x);
-                if (piece != '.')
+                int piece = game->board.squares[screenSquare(gui, y * 8 + x)];
+                if (piece != EMPTY)
                 {
-                    int texture_index;
-                    // Convert piece enum to texture index
-                    switch (piece)
-                    {
-                    case 'P':
-                        texture_index = 0;
-                        break;
-                    case 'N':
-                        texture_index = 1;
-                        break;
-                    case 'B':
-                        texture_index = 2;
-                        break;
-                    case 'R':
-                        texture_index = 3;
-                        break;
-                    case 'Q':
-                        texture_index = 4;
-                        break;
-                    case 'K':
-                        texture_index = 5;
-                        break;
-                    case 'p':
-                        texture_index = 6;
-                        break;
-                    case 'n':
-                        texture_index = 7;
-                        break;
-                    case 'b':
-                        texture_index = 8;
-                        break;
-                    case 'r':
-                        texture_index = 9;
-                        break;
-                    case 'q':
-                        texture_index = 10;
-                        break;
-                    case 'k':
-                        texture_index = 11;
-                        break;
-                    default:
-                        continue;
-                    }
+                    // Textures are white pawn to king, then black pawn to king
+                    int texture_index = PIECE_TYPE(piece) + (PIECE_COLOR(piece) == WHITE ? 0 : 6);
 
                     SDL_Rect pieceRect = {
                         x * SQUARE_SIZE,
@@ -335,16 +408,18 @@ int runGameWindow(SDL_Window **window, Game **game)
             }
         }
 
-        // Fourth pass: Highlight reachable positions
-        Bitboard mask = (*game)->board.reachable_positions;
+        // Fourth pass: Highlight reachable positions, in red where the opponent attacks the square
+        Bitboard mask = gui->reachable_positions;
         SDL_SetRenderDrawBlendMode(rend, SDL_BLENDMODE_BLEND);
-        SDL_SetRenderDrawColor(rend, move_indicator.r, move_indicator.g, move_indicator.b, move_indicator.a);
         for (int square = 0; square < 64; square++)
         {
             if (mask & position_to_Bitboard(square))
             {
-                int centerX = (square % 8) * SQUARE_SIZE + SQUARE_SIZE / 2;
-                int centerY = (square / 8) * SQUARE_SIZE + SQUARE_SIZE / 2;
+                SDL_Color *indicator = (gui->threatened_positions & position_to_Bitboard(square)) ? &threatened_indicator : &move_indicator;
+                SDL_SetRenderDrawColor(rend, indicator->r, indicator->g, indicator->b, indicator->a);
+                int tile = screenSquare(gui, square);
+                int centerX = (tile % 8) * SQUARE_SIZE + SQUARE_SIZE / 2;
+                int centerY = (tile / 8) * SQUARE_SIZE + SQUARE_SIZE / 2;
                 int radius = SQUARE_SIZE / 5;
 
                 // Draw the dot (using a filled circle approximation)
@@ -366,16 +441,17 @@ int runGameWindow(SDL_Window **window, Game **game)
         {
             for (int y = 0; y < BOARD_SIZE; y++)
             {
+                int square = screenSquare(gui, y * 8 + x);
                 if (y == 7)
                 {
-                    char file_str[2] = {'a' + x, '\0'};
+                    char file_str[2] = {'a' + square % 8, '\0'};
                     SDL_Color text_color = (x % 2 == 0) ? light_square : dark_square;
                     renderText(rend, font, file_str, (x + 1) * SQUARE_SIZE - 20,
                                (y + 1) * SQUARE_SIZE - 26, text_color);
                 }
                 if (x == 0)
                 {
-                    char rank_str[2] = {'8' - y, '\0'};
+                    char rank_str[2] = {'8' - square / 8, '\0'};
                     SDL_Color text_color = (y % 2 == 0) ? dark_square : light_square;
                     renderText(rend, font, rank_str, x * SQUARE_SIZE + 2,
                                y * SQUARE_SIZE + 2, text_color);
@@ -383,13 +459,35 @@ int runGameWindow(SDL_Window **window, Game **game)
             }
         }
 
+        // Sixth pass: Outline the suggested moves, numbered by rank on the target tile
+        SDL_SetRenderDrawColor(rend, suggestion.r, suggestion.g, suggestion.b, suggestion.a);
+        for (int i = 0; i < gui->num_suggestions; i++)
+        {
+            int origin = screenSquare(gui, gui->suggestions[i].origin);
+            int target = screenSquare(gui, gui->suggestions[i].target);
+            for (int inset = 0; inset < 3; inset++)
+            {
+                SDL_Rect origin_rect = {(origin % 8) * SQUARE_SIZE + inset, (origin / 8) * SQUARE_SIZE + inset,
+                                        SQUARE_SIZE - 2 * inset, SQUARE_SIZE - 2 * inset};
+                SDL_Rect target_rect = {(target % 8) * SQUARE_SIZE + inset, (target / 8) * SQUARE_SIZE + inset,
+                                        SQUARE_SIZE - 2 * inset, SQUARE_SIZE - 2 * inset};
+                SDL_RenderDrawRect(rend, &origin_rect);
+                SDL_RenderDrawRect(rend, &target_rect);
+            }
+
+            char rank_str[2] = {'1' + i, '\0'};
+            renderText(rend, font, rank_str, (target % 8 + 1) * SQUARE_SIZE - 20,
+                       (target / 8) * SQUARE_SIZE + 2, suggestion);
+        }
+
         // Draw buttons
         drawButton(rend, resetButton, font);
         drawButton(rend, menuButton, font);
+        drawButton(rend, saveButton, font);
 
         // Draw score
         char score_text[50];
-        int score = evaluate_board(*game);
+        int score = evaluate_board(game);
         sprintf(score_text, "Evaluation: %d", score);
         renderText(rend, font, score_text,
                    BOARD_WIDTH + ((WINDOW_WIDTH - BOARD_WIDTH) / 2) - 100,
@@ -397,27 +495,27 @@ int runGameWindow(SDL_Window **window, Game **game)
                    textColor);
 
         // Draw check/checkmate status
-        if ((*game)->isCheck == 0)
+        if (game->isCheck == 0)
             renderText(rend, font, "Stalemate!",
                        BOARD_WIDTH + ((WINDOW_WIDTH - BOARD_WIDTH) / 2) - 100,
                        250,
                        textColor);
-        else if ((*game)->isCheck == 1)
+        else if (game->isCheck == 1)
             renderText(rend, font, "White in Check!",
                        BOARD_WIDTH + ((WINDOW_WIDTH - BOARD_WIDTH) / 2) - 100,
                        250,
                        textColor);
-        else if ((*game)->isCheck == 2)
+        else if (game->isCheck == 2)
             renderText(rend, font, "Black in Check!",
                        BOARD_WIDTH + ((WINDOW_WIDTH - BOARD_WIDTH) / 2) - 100,
                        250,
                        textColor);
-        else if ((*game)->isCheck == 3)
+        else if (game->isCheck == 3)
             renderText(rend, font, "White in Checkmate!",
                        BOARD_WIDTH + ((WINDOW_WIDTH - BOARD_WIDTH) / 2) - 100,
                        250,
                        textColor);
-        else if ((*game)->isCheck == 4)
+        else if (game->isCheck == 4)
             renderText(rend, font, "Black in Checkmate!",
                        BOARD_WIDTH + ((WINDOW_WIDTH - BOARD_WIDTH) / 2) - 100,
                        250,
@@ -439,7 +537,7 @@ int runGameWindow(SDL_Window **window, Game **game)
 
         // Count total moves
         int total_moves = 0;
-        Move *count_current = (*game)->move_history->head;
+        Move *count_current = gui->move_history->head;
         while (count_current != NULL)
         {
             total_moves++;
@@ -447,7 +545,7 @@ int runGameWindow(SDL_Window **window, Game **game)
         }
 
         // Skip to start showing only last 20 moves
-        Move *current = (*game)->move_history->head;
+        Move *current = gui->move_history->head;
         int moves_to_skip = total_moves > 20 ? total_moves - 20 : 0;
         for (int i = 0; i < moves_to_skip; i++)
         {
@@ -495,22 +593,24 @@ int runGameWindow(SDL_Window **window, Game **game)
         SDL_RenderPresent(rend);
 
         // Engine move
-        if ((*game)->numPlayer == 1) // If playing against computer
+        if (gui->numPlayer == 1) // If playing against computer
         {
-            if (((*game)->human_color == 0 && (*game)->is_white_turn) ||
-                ((*game)->human_color == 1 && !(*game)->is_white_turn))
+            if ((gui->human_color == 0 && game->is_white_turn) ||
+                (gui->human_color == 1 && !game->is_white_turn))
             {
-                int success = engine_move(*game);
+                Move played;
+                int success = engine_move(game, &gui->key_history, &played);
                 if (success)
                 {
-                    human_made_move = 1;                    // human made a move
-                    moves_calulated = 0;                    // recalculate possible moves
-                    toggle_turn(*game);                     // Toggle turn
-                    (*game)->selected_position = -1;        // Clear selection
-                    (*game)->board.reachable_positions = 0; // Clear reachable positions
+                    addMove(gui->move_history, played.origin, played.target, played.captured, played.promotion_piece);
+                    human_made_move = 1;          // human made a move
+                    moves_calulated = 0;          // recalculate possible moves
+                    toggle_turn(game);            // Toggle turn
+                    gui->selected_position = -1;  // Clear selection
+                    gui->reachable_positions = 0; // Clear reachable positions
                 }
-                check_check(*game);
-                check_checkmate(*game);
+                check_check(game);
+                check_checkmate(game);
             }
         }
 
@@ -532,40 +632,45 @@ int runGameWindow(SDL_Window **window, Game **game)
                 if (event.button.x < BOARD_WIDTH && event.button.y < BOARD_WIDTH) // if the mouse is in the board
                 {
                     click_temp = (event.button.y / SQUARE_SIZE) * BOARD_SIZE + (event.button.x / SQUARE_SIZE); // 0 - 63 top left to bottom right
+                    click_temp = screenSquare(gui, click_temp);                                                // the board square under the tile
 
                     if (event.button.button == SDL_BUTTON_LEFT)
                     {
-                        if ((*game)->selected_position != -1) // If we already have a piece selected
+                        if (gui->selected_position != -1) // If we already have a piece selected
                         {
                             // Check if the new click position is in the reachable positions
-                            if ((*game)->board.reachable_positions & position_to_Bitboard(click_temp))
+                            if (gui->reachable_positions & position_to_Bitboard(click_temp))
                             {
-                                move(*game, (*game)->selected_position, click_temp);                              // Make the move
-                                addMove((*game)->move_history, (*game)->selected_position, click_temp, '.', '.'); // add move to move history
-                                human_made_move = 1;                                                              // human made a move
-                                moves_calulated = 0;                                                              // recalculate possible moves
-                                if ((*game)->board.promotion_tile != -1)
+                                char piece = get_piece_at_position(&game->board, gui->selected_position);
+                                char captured = get_piece_at_position(&game->board, click_temp);
+                                key_history_push(&gui->key_history, game);                                     // the position moved from
+                                move(game, gui->selected_position, click_temp);                                // Make the move
+                                addMove(gui->move_history, gui->selected_position, click_temp, captured, '.'); // add move to move history
+                                human_made_move = 1;                                                           // human made a move
+                                moves_calulated = 0;                                                           // recalculate possible moves
+                                if ((piece == 'P' || piece == 'p') && (click_temp <= 7 || click_temp >= 56))
                                 {
+                                    gui->promotion_tile = click_temp;
                                     return 4; // promotion window
                                 }
-                                toggle_turn(*game);                     // Toggle turn
-                                (*game)->selected_position = -1;        // Clear selection
-                                (*game)->board.reachable_positions = 0; // Clear reachable positions
-                                check_check(*game);
-                                check_checkmate(*game);
+                                toggle_turn(game);            // Toggle turn
+                                gui->selected_position = -1;  // Clear selection
+                                gui->reachable_positions = 0; // Clear reachable positions
+                                check_check(game);
+                                check_checkmate(game);
                             }
                             else
                             {
                                 // If clicking on a non-reachable position, treat as new selection
-                                (*game)->selected_position = click_temp;
-                                calcReachablePositions(*game);
+                                gui->selected_position = click_temp;
+                                calcReachablePositions(gui);
                             }
                         }
                         else
                         {
                             // First click - select piece
-                            (*game)->selected_position = click_temp;
-                            calcReachablePositions(*game);
+                            gui->selected_position = click_temp;
+                            calcReachablePositions(gui);
                         }
                     }
                 }
@@ -573,7 +678,7 @@ int runGameWindow(SDL_Window **window, Game **game)
                 {
                     if (event.button.button == SDL_BUTTON_LEFT)
                     {
-                        (*game)->selected_position = -1; // Clear selection
+                        gui->selected_position = -1; // Clear selection
                     }
                 }
                 if (event.button.button == SDL_BUTTON_LEFT)
@@ -588,10 +693,14 @@ int runGameWindow(SDL_Window **window, Game **game)
                     }
                     else if (isMouseOverButton(resetButton, mouseX, mouseY))
                     {
-                        (*game)->move_history = createMoveList();
-                        (*game)->is_white_turn = 1;
+                        gui->move_history = createMoveList();
+                        game->is_white_turn = 1;
                         return 2;
                     }
+                    else if (isMouseOverButton(saveButton, mouseX, mouseY))
+                    {
+                        saveGamePgn(gui, "game.pgn");
+                    }
                 }
                 break;
             }
@@ -601,6 +710,7 @@ int runGameWindow(SDL_Window **window, Game **game)
     // Cleanup
     destroyButton(resetButton);
     destroyButton(menuButton);
+    destroyButton(saveButton);
     TTF_CloseFont(font);
     SDL_DestroyRenderer(rend);
 
@@ -610,14 +720,46 @@ int runGameWindow(SDL_Window **window, Game **game)
     return 0;
 }
 
-char runPromotionWindow(SDL_Window **window, Game **game)
+// Appends the game played so far to a PGN file
+void saveGamePgn(GuiState *gui, const char *path)
+{
+    Game *game = &gui->game;
+    FILE *file = fopen(path, "a");
+    if (file == NULL)
+    {
+        printf("ERROR: unable to open %s\n", path);
+        return;
+    }
+
+    PgnTags tags = {0};
+    const char *human = "Human";
+    const char *engine = gui->numPlayer == 1 ? "publicChessEngine" : "Human";
+    snprintf(tags.event, sizeof(tags.event), "%s", gui->numPlayer == 1 ? "Human vs. engine" : "Casual game");
+    snprintf(tags.white, sizeof(tags.white), "%s", gui->human_color == 1 ? human : engine);
+    snprintf(tags.black, sizeof(tags.black), "%s", gui->human_color == 1 ? engine : human);
+    snprintf(tags.result, sizeof(tags.result), "%s", pgn_result(game));
+
+    time_t now = time(NULL);
+    strftime(tags.date, sizeof(tags.date), "%Y.%m.%d", localtime(&now));
+
+    // replay from the initial position
+    Game start = {0};
+    initialize_board(&start);
+
+    pgn_write_game(file, &start, gui->move_history, &tags);
+    fclose(file);
+    printf("Game saved to %s\n", path);
+}
+
+char runPromotionWindow(SDL_Window **window, GuiState *gui)
 {
     // Check inputs
-    if (window == NULL || game == NULL)
+    if (window == NULL || gui == NULL)
     {
         printf("ERROR: runPromotionWindow - invalid parameters\n");
         return '.';
     }
+    Game *game = &gui->game;
 
     // Get current renderer
     SDL_Renderer *rend = SDL_GetRenderer(*window);
@@ -648,7 +790,7 @@ char runPromotionWindow(SDL_Window **window, Game **game)
     int texture_indices[4];
 
     // Determine if we're promoting white or black pieces
-    int base_index = (*game)->is_white_turn ? 0 : 6;
+    int base_index = game->is_white_turn ? 0 : 6;
 
     // Define the promotion pieces (Queen, Rook, Knight, Bishop)
     texture_indices[0] = base_index + 4; // Queen
@@ -699,16 +841,16 @@ char runPromotionWindow(SDL_Window **window, Game **game)
                         switch (i)
                         {
                         case 0:
-                            promotion_piece = (*game)->is_white_turn ? 'Q' : 'q';
+                            promotion_piece = game->is_white_turn ? 'Q' : 'q';
                             break; // Queen
                         case 1:
-                            promotion_piece = (*game)->is_white_turn ? 'R' : 'r';
+                            promotion_piece = game->is_white_turn ? 'R' : 'r';
                             break; // Rook
                         case 2:
-                            promotion_piece = (*game)->is_white_turn ? 'N' : 'n';
+                            promotion_piece = game->is_white_turn ? 'N' : 'n';
                             break; // Knight
                         case 3:
-                            promotion_piece = (*game)->is_white_turn ? 'B' : 'b';
+                            promotion_piece = game->is_white_turn ? 'B' : 'b';
                             break; // Bishop
                         }
                         running = 0;
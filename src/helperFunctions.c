@@ -1,4 +1,4 @@
-#include "a_header.h"
+#include "chessEngine.h"
 
 int Bitboard_to_position(Bitboard bb)
 {
@@ -42,76 +42,137 @@ int get_and_clear_LSB(Bitboard *bb)
 
 MoveList *calculate_all_moves(Game *game, int color)
 {
+    Move moves[MAX_MOVES];
+    int count = generate_legal_moves(game, color, moves);
+
     MoveList *legal_moves = createMoveList();
-    Bitboard piece_bitboard = color ? game->board.white_pieces : game->board.black_pieces;
+    for (int i = 0; i < count; i++)
+    {
+        addMove(legal_moves, moves[i].origin, moves[i].target, moves[i].captured, moves[i].promotion_piece);
+    }
 
-    while (piece_bitboard)
+    return legal_moves;
+}
+
+// Appends the move, unless legal_only is set and it leaves the own king in check; a pawn
+// reaching the last rank is added once for each promotion piece. Returns the new number of moves.
+static int add_move(Game *game, int color, int origin, int target, int is_pawn, int legal_only, Move *moves, int count)
+{
+    if (legal_only && !is_move_legal(game, origin, target))
     {
-        int i = get_and_clear_LSB(&piece_bitboard);
-        char piece = get_piece_at_position(&game->board, i);
+        return count;
+    }
+
+    Move *m = &moves[count];
+    m->origin = origin;
+    m->target = target;
+    m->captured = get_piece_at_position(&game->board, target);
+    m->promotion_piece = '.';
+    m->next = NULL;
+    m->prev = NULL;
+
+    if (!is_pawn || !(position_to_Bitboard(target) & (RANK_1 | RANK_8)))
+    {
+        return count + 1;
+    }
+
+    // Add moves for each promotion piece
+    const char promotion_pieces[] = {'Q', 'R', 'B', 'N'};
+    for (int j = 0; j < 4; j++)
+    {
+        moves[count] = *m;
+        // Convert to lowercase for black pieces
+        moves[count].promotion_piece = color == BLACK ? tolower(promotion_pieces[j]) : promotion_pieces[j];
+        count++;
+    }
+    return count;
+}
+
+// Adds the pawn moves landing on targets, each made by the pawn step squares behind it
+static int add_pawn_moves(Game *game, int color, Bitboard targets, int step, int legal_only, Move *moves, int count)
+{
+    while (targets)
+    {
+        int target = get_and_clear_LSB(&targets);
+        count = add_move(game, color, target - step, target, 1, legal_only, moves, count);
+    }
+    return count;
+}
+
+// Moves of one kind for color: GEN_CAPTURES (captures, en passant and promotions), GEN_QUIETS
+// (everything else, castling included) or GEN_ALL. With legal_only 0 the moves are only
+// pseudo-legal, and the caller checks is_move_legal for the ones it actually plays.
+// moves must hold MAX_MOVES. Returns the number of moves.
+int generate_moves(Game *game, int color, int kind, int legal_only, Move *moves)
+{
+    int count = 0;
+    Bitboard empty = ~(game->board.occupied[WHITE] | game->board.occupied[BLACK]);
+    Bitboard target_mask = kind == GEN_CAPTURES ? game->board.occupied[!color] : kind == GEN_QUIETS ? empty : ~game->board.occupied[color];
+    Bitboard pieces = game->board.occupied[color] & ~game->board.pieces[color][PAWN];
+
+    while (pieces)
+    {
+        int i = get_and_clear_LSB(&pieces);
         Bitboard temporary = 0;
 
-        if (piece == 'P' || piece == 'p')
-        {
-            temporary = calculate_pawn_moves(game, i, 0);
-        }
-        else if (piece == 'r' || piece == 'R')
+        switch (PIECE_TYPE(game->board.squares[i]))
         {
+        case ROOK:
             temporary = calculate_rook_moves(game, i, 0);
-        }
-        else if (piece == 'b' || piece == 'B')
-        {
+            break;
+        case BISHOP:
             temporary = calculate_bishop_moves(game, i, 0);
-        }
-        else if (piece == 'q' || piece == 'Q')
-        {
+            break;
+        case QUEEN:
             temporary = calculate_queen_moves(game, i, 0);
-        }
-        else if (piece == 'n' || piece == 'N')
-        {
+            break;
+        case KNIGHT:
             temporary = calculate_knight_moves(game, i, 0);
-        }
-        else if (piece == 'k' || piece == 'K')
-        {
+            break;
+        case KING:
             temporary = calculate_king_moves(game, i);
+            break;
         }
+        temporary &= target_mask;
 
         while (temporary)
         {
-            int end_position = get_and_clear_LSB(&temporary);
-
-            // Check for pawn promotion
-            if ((piece == 'P' && end_position <= 7 && game->human_color == 1) ||
-                (piece == 'p' && end_position >= 56 && game->human_color == 1) ||
-                (piece == 'P' && end_position >= 56 && game->human_color == 0) ||
-                (piece == 'p' && end_position <= 7 && game->human_color == 0))
-            {
-                // Add moves for each promotion piece
-                char promotion_pieces[] = {'Q', 'R', 'B', 'N'};
-                // Convert to lowercase for black pieces
-                for (int j = 0; j < 4; j++)
-                {
-                    promotion_pieces[j] = piece == 'p' ? tolower(promotion_pieces[j]) : promotion_pieces[j];
-                }
-                for (int j = 0; j < 4; j++)
-                {
-                    if (is_move_legal(game, i, end_position))
-                    {
-                        addMove(legal_moves, i, end_position, get_piece_at_position(&game->board, end_position), promotion_pieces[j]);
-                    }
-                }
-            }
-            else
-            {
-                if (is_move_legal(game, i, end_position))
-                {
-                    addMove(legal_moves, i, end_position, get_piece_at_position(&game->board, end_position), '.');
-                }
-            }
+            count = add_move(game, color, i, get_and_clear_LSB(&temporary), 0, legal_only, moves, count);
         }
     }
 
-    return legal_moves;
+    // All pawns at once: every kind of pawn move is the pawn set shifted by a fixed step.
+    // Pushes onto the last rank are promotions and count as captures.
+    Bitboard pawns = game->board.pieces[color][PAWN];
+    Bitboard capturable = game->board.occupied[!color];
+    if (game->board.en_passant >= 0)
+    {
+        capturable |= position_to_Bitboard(game->board.en_passant);
+    }
+    int forward = color == WHITE ? -8 : 8;
+    Bitboard push_mask = kind == GEN_CAPTURES ? RANK_1 | RANK_8 : kind == GEN_QUIETS ? ~(RANK_1 | RANK_8) : ~0ULL;
+
+    count = add_pawn_moves(game, color, pawn_pushes(pawns, color, empty) & push_mask, forward, legal_only, moves, count);
+    if (kind != GEN_CAPTURES)
+    {
+        count = add_pawn_moves(game, color, pawn_double_pushes(pawns, color, empty), 2 * forward, legal_only, moves, count);
+    }
+    if (kind != GEN_QUIETS)
+    {
+        Bitboard west_captures = (color == WHITE ? (pawns & ~FILE_A) >> 9 : (pawns & ~FILE_A) << 7) & capturable;
+        Bitboard east_captures = (color == WHITE ? (pawns & ~FILE_H) >> 7 : (pawns & ~FILE_H) << 9) & capturable;
+        count = add_pawn_moves(game, color, west_captures, forward - 1, legal_only, moves, count);
+        count = add_pawn_moves(game, color, east_captures, forward + 1, legal_only, moves, count);
+    }
+
+    return count;
+}
+
+// Same as calculate_all_moves, but fills a caller-provided array (at least MAX_MOVES long)
+// so hot loops don't allocate a list node per move. Returns the number of moves.
+int generate_legal_moves(Game *game, int color, Move *moves)
+{
+    return generate_moves(game, color, GEN_ALL, 1, moves);
 }
 
 int is_move_legal(Game *game, int start_position, int end_position)
@@ -120,23 +181,54 @@ int is_move_legal(Game *game, int start_position, int end_position)
     memcpy(&temp_game, game, sizeof(Game));
 
     move(&temp_game, start_position, end_position);
-    update_threat_map(&temp_game);
-    check_check(&temp_game);
 
-    if (temp_game.isCheck == 10)
-        return 0;
+    // Only the mover's own king matters
+    Bitboard king = temp_game.board.pieces[game->is_white_turn][KING];
+    return king == 0 || !is_square_attacked(&temp_game.board, Bitboard_to_position(king), !game->is_white_turn);
+}
 
-    if (temp_game.is_white_turn)
+// Pseudo-legal targets of the side to move's piece of the given type on square
+static Bitboard piece_moves(Game *game, int square, int type)
+{
+    switch (type)
     {
-        if (temp_game.isCheck == 1 || temp_game.isCheck == 3)
-            return 0;
+    case PAWN:
+        return calculate_pawn_moves(game, square, 0);
+    case KNIGHT:
+        return calculate_knight_moves(game, square, 0);
+    case BISHOP:
+        return calculate_bishop_moves(game, square, 0);
+    case ROOK:
+        return calculate_rook_moves(game, square, 0);
+    case QUEEN:
+        return calculate_queen_moves(game, square, 0);
     }
-    else
+    return calculate_king_moves(game, square);
+}
+
+// Whether the side to move has any legal move, without generating them: stops at the first one.
+// King moves come first, they are all that is left in double check and the likely escapes
+// from a mating net; the other pieces follow from the cheapest up.
+int has_legal_move(Game *game)
+{
+    static const int order[6] = {KING, PAWN, KNIGHT, BISHOP, ROOK, QUEEN};
+    int color = game->is_white_turn;
+
+    for (int i = 0; i < 6; i++)
     {
-        if (temp_game.isCheck == 2 || temp_game.isCheck == 4)
-            return 0;
+        Bitboard pieces = game->board.pieces[color][order[i]];
+        while (pieces)
+        {
+            int origin = get_and_clear_LSB(&pieces);
+            Bitboard targets = piece_moves(game, origin, order[i]);
+            while (targets)
+            {
+                if (is_move_legal(game, origin, get_and_clear_LSB(&targets)))
+                    return 1;
+            }
+        }
     }
-    return 1;
+    return 0;
 }
 
 int max(int a, int b)
@@ -160,10 +252,17 @@ void print_piece_values_board(Game *game)
         for (int file = 0; file < 8; file++)
         {
             int position = rank * 8 + file;
-            printf("%4d|", piece_value(get_piece_at_position(&game->board, position), position));
+            printf("%4d|", piece_value(game->board.squares[position], position));
         }
         printf(" %d\n", rank + 1);
         printf("  +----+----+----+----+----+----+----+----+\n");
     }
     printf("    a    b    c    d    e    f    g    h\n");
-}
\ No newline at end of file
+}
+// Wall clock in milliseconds; unlike clock() it isn't summed over all running threads
+long long current_time_ms(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
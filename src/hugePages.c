@@ -0,0 +1,127 @@
+#include "chessEngine.h"
+#include <pthread.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Allocator for large, randomly accessed tables. Memory comes in 2 MB huge pages when the
+// system has them, which saves most of the TLB misses of probing a big hash table:
+// explicit huge pages (MAP_HUGETLB) first, then transparent huge pages (MADV_HUGEPAGE)
+// on 2 MB aligned memory, then plain pages.
+
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+typedef struct
+{
+    char *start;
+    size_t size;
+} ZeroChunk;
+
+static void *zero_chunk(void *argument)
+{
+    ZeroChunk *chunk = (ZeroChunk *)argument;
+    memset(chunk->start, 0, chunk->size);
+    return NULL;
+}
+
+// Touches (and so faults in) and zeroes the memory with one thread per core
+static void prefault(char *memory, size_t size)
+{
+    int num_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    num_threads = max(1, min(num_threads, (int)(size / HUGE_PAGE_SIZE)));
+
+    pthread_t threads[num_threads];
+    ZeroChunk chunks[num_threads];
+    size_t chunk_size = (size / num_threads + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+    int started = 0;
+
+    for (int i = 0; i < num_threads; i++)
+    {
+        size_t offset = (size_t)i * chunk_size;
+        if (offset >= size)
+            break;
+        chunks[i].start = memory + offset;
+        chunks[i].size = offset + chunk_size > size ? size - offset : chunk_size;
+        if (i == num_threads - 1 || pthread_create(&threads[i], NULL, zero_chunk, &chunks[i]) != 0)
+            zero_chunk(&chunks[i]); // the last chunk (or one without a thread) is done here
+        else
+            started++;
+    }
+    for (int i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
+}
+
+// Bytes of the range that the kernel backs with transparent huge pages (Linux only, 0 elsewhere)
+static size_t transparent_huge_bytes(void *memory)
+{
+    FILE *smaps = fopen("/proc/self/smaps", "r");
+    if (smaps == NULL)
+        return 0;
+
+    char line[256];
+    int inside = 0;
+    size_t kilobytes = 0;
+    while (fgets(line, sizeof(line), smaps) != NULL)
+    {
+        unsigned long start, end;
+        if (sscanf(line, "%lx-%lx ", &start, &end) == 2)
+            inside = (uintptr_t)memory >= start && (uintptr_t)memory < end;
+        else if (inside && sscanf(line, "AnonHugePages: %zu kB", &kilobytes) == 1)
+            break;
+    }
+    fclose(smaps);
+    return kilobytes * 1024;
+}
+
+static size_t round_to_huge_pages(size_t size)
+{
+    return (size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+}
+
+// Allocates size bytes of zeroed, pre-faulted memory, in huge pages if possible.
+// huge_bytes (optional) receives how much of it really is in huge pages.
+// Returns NULL on failure; release with large_free and the same size.
+void *large_alloc(size_t size, size_t *huge_bytes)
+{
+    size_t requested = size;
+    size = round_to_huge_pages(size);
+    size_t huge = 0;
+    char *memory = MAP_FAILED;
+
+#ifdef MAP_HUGETLB
+    memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (memory != MAP_FAILED)
+        huge = size;
+#endif
+
+    if (memory == MAP_FAILED)
+    {
+        // Over-allocate so a 2 MB aligned range can be cut out, transparent huge pages need the alignment
+        char *mapping = mmap(NULL, size + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapping == MAP_FAILED)
+        {
+            printf("ERROR: unable to allocate %zu MB\n", size >> 20);
+            return NULL;
+        }
+        memory = (char *)(((uintptr_t)mapping + HUGE_PAGE_SIZE - 1) & ~(uintptr_t)(HUGE_PAGE_SIZE - 1));
+        if (memory > mapping)
+            munmap(mapping, memory - mapping);
+        if (memory + size < mapping + size + HUGE_PAGE_SIZE)
+            munmap(memory + size, mapping + size + HUGE_PAGE_SIZE - (memory + size));
+#ifdef MADV_HUGEPAGE
+        madvise(memory, size, MADV_HUGEPAGE);
+#endif
+    }
+
+    prefault(memory, size);
+    if (huge == 0)
+        huge = transparent_huge_bytes(memory);
+    if (huge_bytes != NULL)
+        *huge_bytes = huge < requested ? huge : requested;
+    return memory;
+}
+
+void large_free(void *memory, size_t size)
+{
+    if (memory != NULL)
+        munmap(memory, round_to_huge_pages(size));
+}
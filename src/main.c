@@ -2,11 +2,16 @@
 
 // compile with         "make"
 // run with             "./build/main"
+// with an opening book "./build/main --book book.bin [--book-depth 20] [--book-best]"
+// with bitbases        "./build/main --bitbases bitbases"
+// any other argument runs a command line tool (see commands.c), e.g. "./build/main uci";
+// "./build/chessengine" runs the same tools without SDL
 int main(int argc, char *argv[])
 {
-    if (argc == 1)
+    if (argc == 1 || argv[1][0] == '-')
     {
-        mainAuxRunGameGUI();
+        mainAuxRunGameGUI(argc, argv);
+        return 0;
     }
-    return 0;
+    return run_command(argc, argv);
 }
@@ -1,11 +1,35 @@
 #include "a_header.h"
-#include <pthread.h>
 #include <string.h>
 
-int mainAuxRunGameGUI(void)
+// GUI options: --book <file.bin>  --book-depth <plies>  --book-best  --bitbases <dir>
+int mainAuxRunGameGUI(int argc, char *argv[])
 {
-    Game *game = NULL;
-    game = initGame();
+    GuiState *gui = initGuiState();
+    if (gui == NULL)
+    {
+        return 0;
+    }
+    Game *game = &gui->game;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--book") == 0 && i + 1 < argc)
+        {
+            game->book = book_open(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--book-depth") == 0 && i + 1 < argc && game->book != NULL)
+        {
+            game->book->max_ply = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--book-best") == 0 && game->book != NULL)
+        {
+            game->book->best_move_only = 1;
+        }
+        else if (strcmp(argv[i], "--bitbases") == 0 && i + 1 < argc)
+        {
+            game->bitbases = bitbases_open(argv[++i]);
+        }
+    }
 
     // initialize SDL2 for video
     if (SDL_Init(SDL_INIT_VIDEO) < 0)
@@ -43,32 +67,31 @@ int mainAuxRunGameGUI(void)
         switch (gameState)
         {
         case 1:
-            gameState = runMainMenu(&window, &game);
+            gameState = runMainMenu(&window, gui);
             break;
         case 2:
-            if (game == NULL)
-            {
-                printf("ERROR: unable to create game\n");
-                SDL_DestroyWindow(window);
-                SDL_Quit();
-                return 0;
-            }
+            gui->key_history.count = 0;
             gameState = initialize_board(game); // if success, gameState = 3
             break;
         case 3:
-            gameState = runGameWindow(&window, &game);
+            gameState = runGameWindow(&window, gui);
             break;
         case 4:
         {
-            char promotion_piece = runPromotionWindow(&window, &game);
+            char promotion_piece = runPromotionWindow(&window, gui);
             if (promotion_piece == '.')
             {
                 printf("ERROR: promotion_piece is NULL\n");
             }
-            gameState = handle_promotion(&game->board, promotion_piece);
+            gameState = handle_promotion(&game->board, gui->promotion_tile, promotion_piece);
+            if (gui->move_history->tail != NULL)
+            {
+                gui->move_history->tail->promotion_piece = promotion_piece;
+            }
             toggle_turn(game);
-            game->selected_position = -1;
-            game->board.reachable_positions = 0;
+            gui->promotion_tile = -1;
+            gui->selected_position = -1;
+            gui->reachable_positions = 0;
             break;
         }
         }
@@ -77,5 +100,7 @@ int mainAuxRunGameGUI(void)
 
     SDL_DestroyWindow(window);
     SDL_Quit();
+    book_close(game->book);
+    bitbases_close(game->bitbases);
     return 1;
 }
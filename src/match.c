@@ -0,0 +1,654 @@
+#include "chessEngine.h"
+#include <fcntl.h>
+#include <math.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Engine-vs-engine matches ("main match"). Games are played concurrently by worker
+// threads; every opening is played twice with colors reversed. Each worker starts its
+// own copy of an external engine, the built-in engine is searched in-process.
+
+// An engine as one worker sees it: an external UCI engine it started,
+// or the transposition table of the built-in engine
+typedef struct
+{
+    pid_t pid;
+    FILE *to_engine;
+    FILE *from_engine;
+    TranspositionTable *tt;
+} UciProcess;
+
+// Shared state of a running match
+typedef struct
+{
+    const MatchOptions *options;
+    char (*openings)[100]; // FENs, every opening is used for a pair of games
+    int num_openings;
+    pthread_mutex_t lock; // guards everything below
+    int next_game;
+    int finished;
+    int wins, losses, draws; // from engines[0]'s point of view
+    int stop;                // set once the SPRT has a result
+    FILE *pgn;
+} Match;
+
+// play_match_game result when the game couldn't be set up
+#define MATCH_GAME_FAILED 2
+
+static pthread_mutex_t spawn_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Starts "sh -c command" with its stdin/stdout connected to pipes. Returns 1 on success.
+static int uci_process_start(UciProcess *process, const char *command)
+{
+    int to_engine[2], from_engine[2];
+
+    // Serialized so no other worker forks while these pipes could still leak into its child
+    pthread_mutex_lock(&spawn_lock);
+    if (pipe(to_engine) < 0 || pipe(from_engine) < 0)
+    {
+        pthread_mutex_unlock(&spawn_lock);
+        printf("ERROR: unable to create pipes for %s\n", command);
+        return 0;
+    }
+    fcntl(to_engine[1], F_SETFD, FD_CLOEXEC);
+    fcntl(from_engine[0], F_SETFD, FD_CLOEXEC);
+
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        dup2(to_engine[0], STDIN_FILENO);
+        dup2(from_engine[1], STDOUT_FILENO);
+        close(to_engine[0]);
+        close(from_engine[1]);
+        execl("/bin/sh", "sh", "-c", command, (char *)NULL);
+        _exit(127);
+    }
+    close(to_engine[0]);
+    close(from_engine[1]);
+    pthread_mutex_unlock(&spawn_lock);
+
+    if (pid < 0)
+    {
+        printf("ERROR: unable to start %s\n", command);
+        close(to_engine[1]);
+        close(from_engine[0]);
+        return 0;
+    }
+
+    process->pid = pid;
+    process->to_engine = fdopen(to_engine[1], "w");
+    process->from_engine = fdopen(from_engine[0], "r");
+    return 1;
+}
+
+static void uci_process_stop(UciProcess *process)
+{
+    if (process->pid <= 0)
+        return;
+
+    fprintf(process->to_engine, "quit\n");
+    fclose(process->to_engine);
+    fclose(process->from_engine);
+    waitpid(process->pid, NULL, 0);
+    process->pid = 0;
+}
+
+// Reads lines until one starts with prefix; the line is left in buffer. Returns 0 if the engine died.
+static int uci_process_wait_for(UciProcess *process, const char *prefix, char *buffer, int size)
+{
+    size_t length = strlen(prefix);
+    while (fgets(buffer, size, process->from_engine) != NULL)
+    {
+        if (strncmp(buffer, prefix, length) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+// "uci", the engine's options, then waits until it is ready
+static int uci_process_init(UciProcess *process, const MatchEngine *engine)
+{
+    char line[1024];
+    if (!uci_process_start(process, engine->command))
+        return 0;
+
+    fprintf(process->to_engine, "uci\n");
+    fflush(process->to_engine);
+    if (!uci_process_wait_for(process, "uciok", line, sizeof(line)))
+    {
+        printf("ERROR: %s doesn't speak UCI\n", engine->command);
+        return 0;
+    }
+
+    for (int i = 0; i < engine->num_options; i++)
+    {
+        const char *value = strchr(engine->options[i], '=');
+        int name_length = (int)(value - engine->options[i]);
+        fprintf(process->to_engine, "setoption name %.*s value %s\n", name_length, engine->options[i], value + 1);
+    }
+    fprintf(process->to_engine, "isready\n");
+    fflush(process->to_engine);
+    return uci_process_wait_for(process, "readyok", line, sizeof(line));
+}
+
+// Applies a "Name=value" option to the built-in engine; names are the ones "main uci" announces
+static int apply_builtin_option(MatchEngine *engine, const char *option)
+{
+    const char *value = strchr(option, '=') + 1;
+
+    if (strncmp(option, "Hash=", 5) == 0)
+    {
+        engine->hash_size = max(atoi(value), 1);
+        return 1;
+    }
+    if (strncmp(option, "BookFile=", 9) == 0)
+    {
+        engine->book = book_open(value);
+        return engine->book != NULL;
+    }
+    if (strncmp(option, "BookDepth=", 10) == 0 && engine->book != NULL)
+    {
+        engine->book->max_ply = atoi(value);
+        return 1;
+    }
+    if (strncmp(option, "BookBest=", 9) == 0 && engine->book != NULL)
+    {
+        engine->book->best_move_only = strcmp(value, "true") == 0;
+        return 1;
+    }
+    if (strncmp(option, "FutilityMargin=", 15) == 0)
+    {
+        engine->params.futility_margin = max(atoi(value), 0);
+        return 1;
+    }
+    if (strncmp(option, "RazorMargin=", 12) == 0)
+    {
+        engine->params.razor_margin = max(atoi(value), 0);
+        return 1;
+    }
+    if (strncmp(option, "Bitbases=", 9) == 0)
+    {
+        bitbases_close(engine->bitbases);
+        engine->bitbases = bitbases_open(value);
+        return engine->bitbases != NULL;
+    }
+    printf("ERROR: unknown option %s for %s (book options must follow BookFile)\n", option, engine->name);
+    return 0;
+}
+
+// Asks the engine on move for its move. history holds the positions before this one.
+// Returns 0 if the engine failed to give a legal move.
+static int request_move(const MatchEngine *engine, UciProcess *process, Game *game, const KeyHistory *history,
+                        const char *start_fen, const char *uci_moves, Move *out)
+{
+    // both engines play on the same game, so each one searches with its own bitbases (or none)
+    game->bitbases = engine->bitbases;
+    if (engine->command[0] == '\0')
+    {
+        if (book_probe(engine->book, game, out))
+            return 1;
+
+        SearchContext context;
+        memset(&context, 0, sizeof(SearchContext));
+        context.limits = engine->limits;
+        context.params = engine->params;
+        context.tt = process->tt;
+        context.history = history;
+        return search_position(game, &context, out);
+    }
+
+    char line[1024];
+    fprintf(process->to_engine, "position fen %s%s%s\n", start_fen, uci_moves[0] != '\0' ? " moves" : "", uci_moves);
+    if (engine->limits.nodes > 0)
+        fprintf(process->to_engine, "go nodes %lld\n", engine->limits.nodes);
+    else if (engine->limits.move_time > 0)
+        fprintf(process->to_engine, "go movetime %d\n", engine->limits.move_time);
+    else
+        fprintf(process->to_engine, "go depth %d\n", engine->limits.depth);
+    fflush(process->to_engine);
+
+    if (!uci_process_wait_for(process, "bestmove ", line, sizeof(line)))
+        return 0;
+    line[strcspn(line + 9, " \r\n") + 9] = '\0';
+    return parse_uci_move(game, line + 9, out);
+}
+
+// Neither side can possibly mate: bare kings, or a single minor piece left
+static int insufficient_material(const Game *game)
+{
+    const ChessBoard *board = &game->board;
+    if (board->pieces[WHITE][PAWN] | board->pieces[BLACK][PAWN] | board->pieces[WHITE][ROOK] | board->pieces[BLACK][ROOK] |
+        board->pieces[WHITE][QUEEN] | board->pieces[BLACK][QUEEN])
+        return 0;
+
+    Bitboard minors = board->pieces[WHITE][KNIGHT] | board->pieces[WHITE][BISHOP] | board->pieces[BLACK][KNIGHT] | board->pieces[BLACK][BISHOP];
+    return (minors & (minors - 1)) == 0;
+}
+
+// Plays one game; returns 1 if white won, -1 if black won, 0 for a draw and
+// MATCH_GAME_FAILED if the game couldn't be played.
+// The reason is written to termination, the moves are appended to history.
+static int play_match_game(const MatchOptions *options, UciProcess processes[2], int white_engine,
+                           const char *start_fen, unsigned int seed, MoveList *history, const char **termination)
+{
+    Game game;
+    memset(&game, 0, sizeof(Game));
+    load_fen(&game, start_fen);
+    game.random_seed = seed;
+
+    int max_plies = options->max_plies;
+    KeyHistory *keys = (KeyHistory *)malloc(sizeof(KeyHistory));
+    char *uci_moves = (char *)malloc(max_plies * 6 + 1);
+    if (keys == NULL || uci_moves == NULL)
+    {
+        printf("ERROR: Failed to create match game\n");
+        free(keys);
+        free(uci_moves);
+        return MATCH_GAME_FAILED;
+    }
+    keys->count = 0;
+    uci_moves[0] = '\0';
+    size_t uci_length = 0;
+    int result = 0;
+
+    for (int ply = 0;; ply++)
+    {
+        uint64_t key = position_key(&game);
+
+        if (!has_legal_move(&game))
+        {
+            int in_check = game.isCheck == 10 || game.isCheck == (game.is_white_turn ? 1 : 2);
+            *termination = in_check ? "checkmate" : "stalemate";
+            result = in_check ? (game.is_white_turn ? -1 : 1) : 0;
+            break;
+        }
+        if (game.halfmove_clock >= 100)
+        {
+            *termination = "fifty move rule";
+            break;
+        }
+        if (insufficient_material(&game))
+        {
+            *termination = "insufficient material";
+            break;
+        }
+
+        int repetitions = 0;
+        for (int i = keys->count - 2; i >= keys->count - game.reversible_plies && i >= 0; i -= 2)
+        {
+            if (keys->keys[i] == key)
+                repetitions++;
+        }
+        if (repetitions >= 2)
+        {
+            *termination = "threefold repetition";
+            break;
+        }
+        if (ply >= max_plies)
+        {
+            *termination = "adjudication";
+            break;
+        }
+
+        int side = game.is_white_turn ? white_engine : 1 - white_engine;
+        Move m;
+        if (!request_move(&options->engines[side], &processes[side], &game, keys, start_fen, uci_moves, &m))
+        {
+            *termination = "illegal move or engine failure";
+            result = game.is_white_turn ? -1 : 1;
+            break;
+        }
+
+        uci_moves[uci_length++] = ' ';
+        move_to_uci(&m, uci_moves + uci_length);
+        uci_length += strlen(uci_moves + uci_length);
+
+        addMove(history, m.origin, m.target, m.captured, m.promotion_piece);
+        key_history_push(keys, &game);
+        play_move(&game, m.origin, m.target, m.promotion_piece);
+    }
+
+    free(keys);
+    free(uci_moves);
+    return result;
+}
+
+// Elo difference for an expected score
+static double score_to_elo(double score)
+{
+    if (score <= 0)
+        return -INFINITY;
+    if (score >= 1)
+        return INFINITY;
+    return -400.0 * log10(1.0 / score - 1.0);
+}
+
+// Elo with the 95% confidence interval and the SPRT log-likelihood ratio (normal approximation)
+static void match_statistics(const Match *match, double *elo, double *error, double *llr)
+{
+    const MatchOptions *options = match->options;
+    int games = match->wins + match->losses + match->draws;
+    double score = (match->wins + 0.5 * match->draws) / games;
+    double variance = (match->wins * pow(1 - score, 2) + match->losses * pow(score, 2) +
+                       match->draws * pow(0.5 - score, 2)) / games;
+    double margin = 1.959964 * sqrt(variance / games);
+
+    *elo = score_to_elo(score);
+    *error = (score_to_elo(score + margin) - score_to_elo(score - margin)) / 2;
+
+    double score0 = 1.0 / (1.0 + pow(10, -options->elo0 / 400.0));
+    double score1 = 1.0 / (1.0 + pow(10, -options->elo1 / 400.0));
+    *llr = variance > 0 ? games * (score1 - score0) * (2 * score - score0 - score1) / (2 * variance) : 0;
+}
+
+static void print_standings(Match *match)
+{
+    const MatchOptions *options = match->options;
+    int games = match->wins + match->losses + match->draws;
+    double elo, error, llr;
+    match_statistics(match, &elo, &error, &llr);
+
+    printf("Score of %s vs %s: %d - %d - %d  [%.3f] %d\n", options->engines[0].name, options->engines[1].name,
+           match->wins, match->losses, match->draws, (match->wins + 0.5 * match->draws) / games, games);
+    printf("Elo difference: %.1f +/- %.1f", elo, error);
+
+    if (options->sprt)
+    {
+        double lower = log(options->beta / (1 - options->alpha));
+        double upper = log((1 - options->beta) / options->alpha);
+        printf(", LLR: %.2f (%.2f, %.2f)", llr, lower, upper);
+        if (llr >= upper)
+        {
+            printf(" - H1 accepted (elo >= %.1f)", options->elo1);
+            match->stop = 1;
+        }
+        else if (llr <= lower)
+        {
+            printf(" - H0 accepted (elo <= %.1f)", options->elo0);
+            match->stop = 1;
+        }
+    }
+    printf("\n");
+    fflush(stdout);
+}
+
+static void *match_worker(void *argument)
+{
+    Match *match = (Match *)argument;
+    const MatchOptions *options = match->options;
+    UciProcess processes[2];
+    memset(processes, 0, sizeof(processes));
+
+    for (int i = 0; i < 2; i++)
+    {
+        if (options->engines[i].command[0] == '\0')
+            processes[i].tt = tt_create(options->engines[i].hash_size);
+        else if (!uci_process_init(&processes[i], &options->engines[i]))
+        {
+            uci_process_stop(&processes[0]);
+            uci_process_stop(&processes[1]);
+            tt_free(processes[0].tt);
+            tt_free(processes[1].tt);
+            return NULL;
+        }
+    }
+
+    while (1)
+    {
+        pthread_mutex_lock(&match->lock);
+        int index = match->next_game++;
+        int stop = match->stop || index >= options->games;
+        pthread_mutex_unlock(&match->lock);
+        if (stop)
+            break;
+
+        for (int i = 0; i < 2; i++)
+        {
+            tt_clear(processes[i].tt);
+            if (processes[i].pid > 0)
+            {
+                fprintf(processes[i].to_engine, "ucinewgame\n");
+                fflush(processes[i].to_engine);
+            }
+        }
+
+        const char *start_fen = match->openings[(index / 2) % match->num_openings];
+        int white_engine = index % 2;
+        MoveList *history = createMoveList();
+        const char *termination = "";
+        int result = history == NULL ? MATCH_GAME_FAILED
+                                     : play_match_game(options, processes, white_engine, start_fen,
+                                                       options->seed + index, history, &termination);
+        if (result == MATCH_GAME_FAILED)
+        {
+            // out of memory, this worker can't go on
+            free_move_list(history);
+            break;
+        }
+
+        PgnTags tags;
+        memset(&tags, 0, sizeof(PgnTags));
+        strcpy(tags.event, "Engine match");
+        snprintf(tags.round, sizeof(tags.round), "%d", index + 1);
+        strcpy(tags.white, options->engines[white_engine].name);
+        strcpy(tags.black, options->engines[1 - white_engine].name);
+        strcpy(tags.result, result > 0 ? "1-0" : result < 0 ? "0-1" : "1/2-1/2");
+        time_t now = time(NULL);
+        strftime(tags.date, sizeof(tags.date), "%Y.%m.%d", localtime(&now));
+        if (strcmp(start_fen, START_FEN) != 0)
+            strcpy(tags.fen, start_fen);
+
+        Game start;
+        memset(&start, 0, sizeof(Game));
+        load_fen(&start, start_fen);
+
+        pthread_mutex_lock(&match->lock);
+        int engine_result = white_engine == 0 ? result : -result;
+        if (engine_result > 0)
+            match->wins++;
+        else if (engine_result < 0)
+            match->losses++;
+        else
+            match->draws++;
+        match->finished++;
+
+        if (match->pgn != NULL)
+        {
+            pgn_write_game(match->pgn, &start, history, &tags);
+            fflush(match->pgn);
+        }
+        printf("Finished game %d (%s vs %s): %s {%s}\n", index + 1, tags.white, tags.black, tags.result, termination);
+        print_standings(match);
+        pthread_mutex_unlock(&match->lock);
+
+        free_move_list(history);
+    }
+
+    uci_process_stop(&processes[0]);
+    uci_process_stop(&processes[1]);
+    tt_free(processes[0].tt);
+    tt_free(processes[1].tt);
+    return NULL;
+}
+
+// Reads the openings: every position of an EPD file, or random walks through a Polyglot book.
+// Positions are normalized through load_fen/write_fen. Returns the number of openings, 0 on error.
+static int load_openings(const MatchOptions *options, char (**openings)[100])
+{
+    int count = 0;
+    int capacity = 64;
+    *openings = malloc(capacity * sizeof(**openings));
+    if (*openings == NULL)
+    {
+        printf("ERROR: Failed to create openings\n");
+        return 0;
+    }
+
+    if (options->openings == NULL)
+    {
+        strcpy((*openings)[0], START_FEN);
+        return 1;
+    }
+
+    size_t length = strlen(options->openings);
+    if (length > 4 && strcmp(options->openings + length - 4, ".bin") == 0)
+    {
+        OpeningBook *book = book_open(options->openings);
+        if (book == NULL)
+            return 0;
+        book->max_ply = options->book_plies;
+
+        // one opening per pair of games
+        count = (options->games + 1) / 2;
+        char (*resized)[100] = realloc(*openings, count * sizeof(**openings));
+        if (resized == NULL)
+        {
+            printf("ERROR: Failed to create openings\n");
+            book_close(book);
+            return 0;
+        }
+        *openings = resized;
+        for (int i = 0; i < count; i++)
+        {
+            Game game;
+            memset(&game, 0, sizeof(Game));
+            load_fen(&game, START_FEN);
+            game.random_seed = options->seed + i;
+
+            Move m;
+            while (book_probe(book, &game, &m))
+            {
+                play_move(&game, m.origin, m.target, m.promotion_piece);
+            }
+            write_fen(&game, (*openings)[i]);
+        }
+        book_close(book);
+        return count;
+    }
+
+    FILE *file = fopen(options->openings, "r");
+    if (file == NULL)
+    {
+        printf("ERROR: unable to open %s\n", options->openings);
+        return 0;
+    }
+
+    char line[1024];
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        if (line[0] == '#' || line[0] == '\n' || line[0] == '\r')
+            continue;
+
+        Game game;
+        memset(&game, 0, sizeof(Game));
+        if (!load_fen(&game, line))
+        {
+            printf("ERROR: skipping invalid EPD line: %s", line);
+            continue;
+        }
+        if (count == capacity)
+        {
+            char (*resized)[100] = realloc(*openings, 2 * capacity * sizeof(**openings));
+            if (resized == NULL)
+            {
+                printf("ERROR: Failed to create openings\n");
+                fclose(file);
+                return 0;
+            }
+            capacity *= 2;
+            *openings = resized;
+        }
+        write_fen(&game, (*openings)[count++]);
+    }
+    fclose(file);
+
+    if (count == 0)
+        printf("ERROR: no positions in %s\n", options->openings);
+    return count;
+}
+
+int run_match(MatchOptions *options)
+{
+    if (options->games <= 0)
+    {
+        printf("ERROR: a match needs at least one game\n");
+        return 0;
+    }
+
+    Match match;
+    memset(&match, 0, sizeof(Match));
+    match.options = options;
+    pthread_mutex_init(&match.lock, NULL);
+
+    // a dead external engine shouldn't kill the match
+    signal(SIGPIPE, SIG_IGN);
+
+    for (int i = 0; i < 2; i++)
+    {
+        MatchEngine *engine = &options->engines[i];
+        if (engine->command[0] != '\0')
+            continue;
+        for (int j = 0; j < engine->num_options; j++)
+        {
+            if (!apply_builtin_option(engine, engine->options[j]))
+                return 0;
+        }
+    }
+
+    match.num_openings = load_openings(options, &match.openings);
+    if (match.num_openings == 0)
+    {
+        free(match.openings);
+        return 0;
+    }
+
+    if (options->pgn_path != NULL)
+    {
+        match.pgn = fopen(options->pgn_path, "a");
+        if (match.pgn == NULL)
+            printf("ERROR: unable to open %s, games won't be saved\n", options->pgn_path);
+    }
+
+    printf("Match %s vs %s: %d games, %d openings, %d threads\n", options->engines[0].name,
+           options->engines[1].name, options->games, match.num_openings, options->concurrency);
+
+    long long start = current_time_ms();
+    pthread_t *threads = (pthread_t *)malloc(options->concurrency * sizeof(pthread_t));
+    if (threads == NULL)
+    {
+        printf("ERROR: Failed to create match threads\n");
+        if (match.pgn != NULL)
+            fclose(match.pgn);
+        free(match.openings);
+        pthread_mutex_destroy(&match.lock);
+        return 0;
+    }
+    for (int i = 0; i < options->concurrency; i++)
+    {
+        pthread_create(&threads[i], NULL, match_worker, &match);
+    }
+    for (int i = 0; i < options->concurrency; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+
+    if (match.finished > 0)
+    {
+        printf("\nFinal result after %d games (%.1f seconds):\n", match.finished, (current_time_ms() - start) / 1000.0);
+        print_standings(&match);
+    }
+
+    if (match.pgn != NULL)
+        fclose(match.pgn);
+    for (int i = 0; i < 2; i++)
+    {
+        book_close(options->engines[i].book);
+        bitbases_close(options->engines[i].bitbases);
+    }
+    free(match.openings);
+    pthread_mutex_destroy(&match.lock);
+    return match.finished > 0;
+}
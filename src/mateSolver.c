@@ -0,0 +1,313 @@
+#include "chessEngine.h"
+
+// Mate-in-N solver: depth-first proof-number search (df-pn). Every position has a proof number,
+// the fewest positions still to be shown mated to prove a mate from it, and a disproof number,
+// the fewest to be shown escaping to refute one. The search always expands the most proving
+// position and only returns to the parent once the numbers cross the thresholds it was given,
+// so it goes deep where the defender has few replies, which is what forced mates look like.
+// The attacker is the side to move at the root. Positions are stored together with the plies
+// left, so a line can't run into itself and every result holds for exactly that distance.
+// Repetitions and the fifty-move rule are ignored, as in mate problems.
+
+#define PN_INFINITY 100000000u
+#define MATE_BUCKET_SIZE 4 // entries per bucket, 64 bytes
+
+typedef struct
+{
+    uint32_t check; // upper half of the key
+    uint32_t work;  // positions expanded below this one, the cheapest entry is replaced first
+    uint32_t pn;    // proof number, 0 for proven
+    uint32_t dn;    // disproof number, 0 for disproven; both 0 is an empty slot
+} MateEntry;
+
+typedef struct
+{
+    MateEntry *entries;
+    uint64_t num_buckets;
+    size_t size; // bytes, for large_free
+    int attacker; // is_white_turn of the root
+    long long nodes;
+    long long max_nodes;
+    int stop;
+} MateSolver;
+
+// Key of a position with the plies left
+static uint64_t node_key(const Game *game, int remaining)
+{
+    return position_key(game) ^ (uint64_t)(remaining + 1) * 0x9E3779B97F4A7C15ULL;
+}
+
+static MateEntry *find_entry(const MateSolver *solver, uint64_t key)
+{
+    MateEntry *bucket = solver->entries + (key & (solver->num_buckets - 1)) * MATE_BUCKET_SIZE;
+    for (int i = 0; i < MATE_BUCKET_SIZE; i++)
+    {
+        if (bucket[i].check == (uint32_t)(key >> 32) && (bucket[i].pn != 0 || bucket[i].dn != 0))
+            return &bucket[i];
+    }
+    return NULL;
+}
+
+// A position not in the table counts as one position to prove and one to disprove
+static void lookup(const MateSolver *solver, uint64_t key, uint32_t *pn, uint32_t *dn, uint32_t *work)
+{
+    const MateEntry *entry = find_entry(solver, key);
+    *pn = entry != NULL ? entry->pn : 1;
+    *dn = entry != NULL ? entry->dn : 1;
+    if (work != NULL)
+        *work = entry != NULL ? entry->work : 0;
+}
+
+// The key's own slot is updated; otherwise an empty slot is used, or else the one with the least work
+static void store(MateSolver *solver, uint64_t key, uint32_t pn, uint32_t dn, long long work)
+{
+    MateEntry *entry = find_entry(solver, key);
+    if (entry == NULL)
+    {
+        MateEntry *bucket = solver->entries + (key & (solver->num_buckets - 1)) * MATE_BUCKET_SIZE;
+        entry = &bucket[0];
+        for (int i = 0; i < MATE_BUCKET_SIZE; i++)
+        {
+            if (bucket[i].pn == 0 && bucket[i].dn == 0)
+            {
+                entry = &bucket[i];
+                break;
+            }
+            if (bucket[i].work < entry->work)
+                entry = &bucket[i];
+        }
+    }
+    entry->check = (uint32_t)(key >> 32);
+    entry->work = work > UINT32_MAX ? UINT32_MAX : (uint32_t)work;
+    entry->pn = pn;
+    entry->dn = dn;
+}
+
+// Expands the position until its proof number reaches th_pn or its disproof number th_dn,
+// and returns both in pn and dn
+static void mid(MateSolver *solver, Game *game, uint64_t key, int remaining, uint32_t th_pn, uint32_t th_dn,
+                uint32_t *pn, uint32_t *dn)
+{
+    long long nodes_before = solver->nodes++;
+    if (solver->max_nodes > 0 && solver->nodes >= solver->max_nodes)
+    {
+        solver->stop = 1;
+    }
+    int attacking = game->is_white_turn == solver->attacker;
+
+    // Out of plies: only a defender who is mated already counts
+    if (remaining == 0)
+    {
+        int mated = !attacking && checkers(game) != 0 && !has_legal_move(game);
+        *pn = mated ? 0 : PN_INFINITY;
+        *dn = mated ? PN_INFINITY : 0;
+        store(solver, key, *pn, *dn, 1);
+        return;
+    }
+
+    Move moves[MAX_MOVES];
+    int count = generate_legal_moves(game, game->is_white_turn, moves);
+    if (count == 0)
+    {
+        int mated = !attacking && checkers(game) != 0;
+        *pn = mated ? 0 : PN_INFINITY;
+        *dn = mated ? PN_INFINITY : 0;
+        store(solver, key, *pn, *dn, 1);
+        return;
+    }
+
+    uint64_t child_keys[MAX_MOVES];
+    uint32_t child_pn[MAX_MOVES];
+    uint32_t child_dn[MAX_MOVES];
+    for (int i = 0; i < count; i++)
+    {
+        Game child;
+        memcpy(&child, game, sizeof(Game));
+        play_move(&child, moves[i].origin, moves[i].target, moves[i].promotion_piece);
+        child_keys[i] = node_key(&child, remaining - 1);
+        lookup(solver, child_keys[i], &child_pn[i], &child_dn[i], NULL);
+    }
+
+    while (1)
+    {
+        // The attacker needs one move that mates and the defender one that escapes, so a
+        // node takes the smallest number of its side and the sum of the other
+        uint32_t best = PN_INFINITY;
+        uint32_t second = PN_INFINITY;
+        uint32_t sum = 0;
+        int best_index = 0;
+        for (int i = 0; i < count; i++)
+        {
+            uint32_t own = attacking ? child_pn[i] : child_dn[i];
+            uint32_t other = attacking ? child_dn[i] : child_pn[i];
+            sum = min(sum + other, PN_INFINITY);
+            if (own < best)
+            {
+                second = best;
+                best = own;
+                best_index = i;
+            }
+            else if (own < second)
+            {
+                second = own;
+            }
+        }
+        *pn = attacking ? best : sum;
+        *dn = attacking ? sum : best;
+        if (*pn >= th_pn || *dn >= th_dn || solver->stop)
+        {
+            break;
+        }
+
+        // The child is searched until it stops being the best one or the node crosses a threshold
+        uint32_t child_th_pn, child_th_dn;
+        if (attacking)
+        {
+            child_th_pn = min(th_pn, second + 1);
+            child_th_dn = th_dn - *dn + child_dn[best_index];
+        }
+        else
+        {
+            child_th_pn = th_pn - *pn + child_pn[best_index];
+            child_th_dn = min(th_dn, second + 1);
+        }
+
+        Game child;
+        memcpy(&child, game, sizeof(Game));
+        const Move *m = &moves[best_index];
+        play_move(&child, m->origin, m->target, m->promotion_piece);
+        mid(solver, &child, child_keys[best_index], remaining - 1, child_th_pn, child_th_dn,
+            &child_pn[best_index], &child_dn[best_index]);
+    }
+
+    store(solver, key, *pn, *dn, solver->nodes - nodes_before);
+}
+
+// Searches the position with the plies left until it is proven or disproven (or the budget is spent)
+static int prove(MateSolver *solver, Game *game, int remaining)
+{
+    uint64_t key = node_key(game, remaining);
+    uint32_t pn, dn;
+    lookup(solver, key, &pn, &dn, NULL);
+    if (pn != 0 && dn != 0)
+    {
+        mid(solver, game, key, remaining, PN_INFINITY, PN_INFINITY, &pn, &dn);
+    }
+    return pn == 0 ? MATE_FOUND : dn == 0 ? MATE_NONE : MATE_UNKNOWN;
+}
+
+// Follows the proof from the root, which is mated in exactly remaining plies and no fewer.
+// Every move still proven to mate in time keeps that true for the attacker, who takes the one
+// that was cheapest to prove. The defender plays a move that isn't mated two plies sooner,
+// the one that was hardest to prove, so the line is as long as the mate.
+static void extract_line(MateSolver *solver, const Game *game, int remaining, MateSolution *solution)
+{
+    Game position;
+    memcpy(&position, game, sizeof(Game));
+
+    while (remaining > 0)
+    {
+        Move moves[MAX_MOVES];
+        int count = generate_legal_moves(&position, position.is_white_turn, moves);
+        int attacking = position.is_white_turn == solver->attacker;
+        int chosen = -1;
+        uint32_t chosen_work = 0;
+
+        // Positions the table has lost since are proven again; the attacker only does that
+        // if none of its moves is still known to mate
+        for (int pass = 0; pass < 2 && chosen < 0; pass++)
+        {
+            for (int i = 0; i < count; i++)
+            {
+                Game child;
+                memcpy(&child, &position, sizeof(Game));
+                play_move(&child, moves[i].origin, moves[i].target, moves[i].promotion_piece);
+
+                uint32_t pn, dn, work;
+                lookup(solver, node_key(&child, remaining - 1), &pn, &dn, &work);
+                if (pn != 0 && dn != 0 && (pass == 1 || !attacking) && prove(solver, &child, remaining - 1) == MATE_FOUND)
+                {
+                    lookup(solver, node_key(&child, remaining - 1), &pn, &dn, &work);
+                    pn = 0;
+                }
+                if (pn != 0)
+                {
+                    continue;
+                }
+                if (!attacking && remaining >= 4 && prove(solver, &child, remaining - 3) == MATE_FOUND)
+                {
+                    continue; // the position would be mated sooner
+                }
+                if (chosen < 0 || (attacking ? work < chosen_work : work > chosen_work))
+                {
+                    chosen = i;
+                    chosen_work = work;
+                }
+            }
+        }
+        if (chosen < 0)
+        {
+            break; // the defender is mated
+        }
+
+        solution->line[solution->length++] = moves[chosen];
+        play_move(&position, moves[chosen].origin, moves[chosen].target, moves[chosen].promotion_piece);
+        remaining--;
+    }
+}
+
+// Looks for the shortest mate by the side to move in at most max_moves moves. Returns 0 on
+// invalid input or if the table can't be allocated, 1 otherwise with the outcome in solution.
+int solve_mate(Game *game, int max_moves, const MateSolverOptions *options, MateSolution *solution)
+{
+    memset(solution, 0, sizeof(MateSolution));
+    solution->result = MATE_UNKNOWN;
+    if (max_moves < 1 || 2 * max_moves - 1 > MAX_SEARCH_DEPTH)
+    {
+        printf("ERROR: a mate search goes 1 to %d moves deep\n", (MAX_SEARCH_DEPTH + 1) / 2);
+        return 0;
+    }
+
+    MateSolver solver;
+    memset(&solver, 0, sizeof(MateSolver));
+    solver.num_buckets = 1;
+    while (solver.num_buckets * 2 * MATE_BUCKET_SIZE * sizeof(MateEntry) <= options->memory_mb * 1024 * 1024)
+    {
+        solver.num_buckets *= 2;
+    }
+    solver.size = solver.num_buckets * MATE_BUCKET_SIZE * sizeof(MateEntry);
+    solver.entries = (MateEntry *)large_alloc(solver.size, NULL);
+    if (solver.entries == NULL)
+    {
+        printf("ERROR: unable to allocate a %zu MB mate solver table\n", options->memory_mb);
+        return 0;
+    }
+    solver.attacker = game->is_white_turn;
+    solver.max_nodes = options->max_nodes;
+
+    // One move deeper at a time, so the first mate found is the shortest. The table carries
+    // over, its positions are stored with the plies left.
+    int remaining = 0;
+    for (int moves = 1; moves <= max_moves; moves++)
+    {
+        remaining = 2 * moves - 1;
+        solution->result = prove(&solver, game, remaining);
+        if (solution->result != MATE_NONE)
+        {
+            break;
+        }
+    }
+    solution->nodes = solver.nodes;
+
+    // The line only retraces the proof, the budget doesn't apply to it
+    if (solution->result == MATE_FOUND)
+    {
+        solution->mate_in = (remaining + 1) / 2;
+        solver.max_nodes = 0;
+        solver.stop = 0;
+        extract_line(&solver, game, remaining, solution);
+    }
+
+    large_free(solver.entries, solver.size);
+    return 1;
+}
@@ -1,4 +1,4 @@
-#include "a_header.h"
+#include "chessEngine.h"
 
 // Initialize a new move list
 MoveList *createMoveList()
@@ -0,0 +1,251 @@
+#include "chessEngine.h"
+
+// Staged move picker. Most nodes of an alpha-beta search are cut off by their first or
+// second move, so moves are produced in the order they are likely to cut and each stage is
+// only generated when the search asks for more: the hash move needs no generation at all,
+// and the quiet moves, the bulk of the list, are never generated at a cut node that a
+// capture or killer refuted. Moves are generated pseudo-legal and checked when handed out.
+// Captures that lose material by static exchange evaluation come last, after the quiets.
+
+#define STAGE_HASH_MOVE 0
+#define STAGE_GENERATE_CAPTURES 1
+#define STAGE_CAPTURES 2
+#define STAGE_KILLERS 3
+#define STAGE_GENERATE_QUIETS 4
+#define STAGE_QUIETS 5
+#define STAGE_BAD_CAPTURES 6
+#define STAGE_DONE 7
+
+int same_move(const Move *a, const Move *b)
+{
+    return a->origin == b->origin && a->target == b->target && a->promotion_piece == b->promotion_piece;
+}
+
+// A move that neither captures nor promotes (killers are only kept for those)
+int is_quiet_move(const Game *game, const Move *m)
+{
+    if (m->promotion_piece != '.' || game->board.squares[m->target] != EMPTY)
+        return 0;
+
+    // en passant lands on an empty square too
+    return PIECE_TYPE(game->board.squares[m->origin]) != PAWN || m->origin % 8 == m->target % 8;
+}
+
+// Whether a move that didn't come from the generator (hash move, killer) can be played here
+static int is_playable(Game *game, const Move *m)
+{
+    int piece = game->board.squares[m->origin];
+    if (m->origin == m->target || piece == EMPTY || PIECE_COLOR(piece) != game->is_white_turn)
+        return 0;
+
+    Bitboard targets = 0;
+    switch (PIECE_TYPE(piece))
+    {
+    case PAWN:
+        targets = calculate_pawn_moves(game, m->origin, 0);
+        break;
+    case KNIGHT:
+        targets = calculate_knight_moves(game, m->origin, 0);
+        break;
+    case BISHOP:
+        targets = calculate_bishop_moves(game, m->origin, 0);
+        break;
+    case ROOK:
+        targets = calculate_rook_moves(game, m->origin, 0);
+        break;
+    case QUEEN:
+        targets = calculate_queen_moves(game, m->origin, 0);
+        break;
+    case KING:
+        targets = calculate_king_moves(game, m->origin);
+        break;
+    }
+    if (!(targets & position_to_Bitboard(m->target)))
+        return 0;
+
+    // a pawn reaching the last rank has to promote, nothing else may
+    int promotes = PIECE_TYPE(piece) == PAWN && (position_to_Bitboard(m->target) & (RANK_1 | RANK_8));
+    if (promotes != (m->promotion_piece != '.'))
+        return 0;
+
+    return is_move_legal(game, m->origin, m->target);
+}
+
+// Most valuable victim, then least valuable attacker; promotions by the piece they make
+static int capture_score(const Game *game, const Move *m)
+{
+    int victim = game->board.squares[m->target];
+    int score = victim == EMPTY ? 0 : 8 * (PIECE_TYPE(victim) + 1);
+    if (m->promotion_piece != '.')
+        score += 8 * PIECE_TYPE(piece_code(m->promotion_piece));
+    return score + KING - PIECE_TYPE(game->board.squares[m->origin]);
+}
+
+// killers holds the two killer moves of this ply (entries with origin == target are empty)
+void move_picker_init(MovePicker *picker, Game *game, const TTEntry *entry, const Move killers[2])
+{
+    picker->game = game;
+    picker->stage = STAGE_HASH_MOVE;
+    if (!tt_decode_move(entry, game, &picker->hash_move))
+    {
+        picker->hash_move.origin = picker->hash_move.target = 0;
+        picker->hash_move.promotion_piece = '.';
+    }
+    picker->killers[0] = killers[0];
+    picker->killers[1] = killers[1];
+    picker->killer_index = 0;
+    picker->count = 0;
+    picker->index = 0;
+    picker->bad_count = 0;
+    picker->quiescence = 0;
+}
+
+// Captures and promotions only, leaving out those that lose material (quiescence search)
+void move_picker_init_quiescence(MovePicker *picker, Game *game)
+{
+    picker->game = game;
+    picker->stage = STAGE_GENERATE_CAPTURES;
+    picker->hash_move.origin = picker->hash_move.target = 0;
+    picker->hash_move.promotion_piece = '.';
+    picker->killer_index = 2;
+    picker->count = 0;
+    picker->index = 0;
+    picker->bad_count = 0;
+    picker->quiescence = 1;
+}
+
+// Only a capture with a more valuable piece than the victim, or a promotion, can lose the exchange
+static int loses_exchange(const Game *game, const Move *m)
+{
+    int victim = game->board.squares[m->target];
+    int attacker = PIECE_TYPE(game->board.squares[m->origin]);
+    if (m->promotion_piece == '.' && (victim == EMPTY || piece_values[attacker] <= piece_values[PIECE_TYPE(victim)]))
+        return 0;
+
+    return see(&game->board, m) < 0;
+}
+
+// Hands out the generated capture with the highest score that hasn't been handed out yet.
+// Losing captures are moved to the front of the list, behind the ones already handed out.
+static int pick_best(MovePicker *picker, Move *m)
+{
+    while (picker->index < picker->count)
+    {
+        int best = picker->index;
+        for (int i = picker->index + 1; i < picker->count; i++)
+        {
+            if (picker->scores[i] > picker->scores[best])
+                best = i;
+        }
+
+        Move swap_move = picker->moves[best];
+        picker->moves[best] = picker->moves[picker->index];
+        picker->moves[picker->index] = swap_move;
+        int swap_score = picker->scores[best];
+        picker->scores[best] = picker->scores[picker->index];
+        picker->scores[picker->index] = swap_score;
+
+        *m = picker->moves[picker->index++];
+        if (same_move(m, &picker->hash_move))
+            continue;
+        if (loses_exchange(picker->game, m))
+        {
+            picker->moves[picker->bad_count++] = *m;
+            continue;
+        }
+        if (is_move_legal(picker->game, m->origin, m->target))
+            return 1;
+    }
+    return 0;
+}
+
+// Stores the next legal move in m. Returns 0 once every move has been handed out.
+int move_picker_next(MovePicker *picker, Move *m)
+{
+    Game *game = picker->game;
+
+    while (1)
+    {
+        switch (picker->stage)
+        {
+        case STAGE_HASH_MOVE:
+            picker->stage = STAGE_GENERATE_CAPTURES;
+            if (picker->hash_move.origin != picker->hash_move.target && is_playable(game, &picker->hash_move))
+            {
+                *m = picker->hash_move;
+                return 1;
+            }
+            picker->hash_move.origin = picker->hash_move.target = 0; // nothing to skip later
+            break;
+
+        case STAGE_GENERATE_CAPTURES:
+            picker->count = generate_moves(game, game->is_white_turn, GEN_CAPTURES, 0, picker->moves);
+            for (int i = 0; i < picker->count; i++)
+            {
+                picker->scores[i] = capture_score(game, &picker->moves[i]);
+            }
+            picker->index = 0;
+            picker->stage = STAGE_CAPTURES;
+            break;
+
+        case STAGE_CAPTURES:
+            if (pick_best(picker, m))
+                return 1;
+            // the quiescence search neither plays quiet moves nor losing captures
+            picker->stage = picker->quiescence ? STAGE_DONE : STAGE_KILLERS;
+            break;
+
+        case STAGE_KILLERS:
+            while (picker->killer_index < 2)
+            {
+                const Move *killer = &picker->killers[picker->killer_index++];
+                if (killer->origin != killer->target && !same_move(killer, &picker->hash_move) &&
+                    is_quiet_move(game, killer) && is_playable(game, killer))
+                {
+                    *m = *killer;
+                    m->captured = '.';
+                    m->next = NULL;
+                    m->prev = NULL;
+                    return 1;
+                }
+            }
+            picker->stage = STAGE_GENERATE_QUIETS;
+            break;
+
+        case STAGE_GENERATE_QUIETS:
+            // quiet moves keep the generator's order and go behind the losing captures
+            picker->count = picker->bad_count + generate_moves(game, game->is_white_turn, GEN_QUIETS, 0, picker->moves + picker->bad_count);
+            picker->index = picker->bad_count;
+            picker->stage = STAGE_QUIETS;
+            break;
+
+        case STAGE_QUIETS:
+            while (picker->index < picker->count)
+            {
+                *m = picker->moves[picker->index++];
+                // the hash move and the killers were handed out already
+                if (same_move(m, &picker->hash_move) || same_move(m, &picker->killers[0]) || same_move(m, &picker->killers[1]))
+                    continue;
+                if (is_move_legal(game, m->origin, m->target))
+                    return 1;
+            }
+            picker->count = picker->bad_count;
+            picker->index = 0;
+            picker->stage = STAGE_BAD_CAPTURES;
+            break;
+
+        case STAGE_BAD_CAPTURES:
+            while (picker->index < picker->count)
+            {
+                *m = picker->moves[picker->index++];
+                if (is_move_legal(game, m->origin, m->target))
+                    return 1;
+            }
+            picker->stage = STAGE_DONE;
+            break;
+
+        default:
+            return 0;
+        }
+    }
+}
@@ -0,0 +1,599 @@
+#include "chessEngine.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+PgnReader *pgn_open(const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        printf("ERROR: unable to open %s\n", path);
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0)
+    {
+        printf("ERROR: unable to stat %s\n", path);
+        close(fd);
+        return NULL;
+    }
+
+    PgnReader *reader = (PgnReader *)malloc(sizeof(PgnReader));
+    if (reader == NULL)
+    {
+        printf("ERROR: Failed to create PGN reader\n");
+        close(fd);
+        return NULL;
+    }
+
+    reader->fd = fd;
+    reader->size = (size_t)st.st_size;
+    reader->offset = 0;
+    reader->data = NULL;
+
+    if (reader->size > 0)
+    {
+        void *data = mmap(NULL, reader->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED)
+        {
+            printf("ERROR: unable to map %s\n", path);
+            close(fd);
+            free(reader);
+            return NULL;
+        }
+        // the file is read front to back exactly once
+        madvise(data, reader->size, MADV_SEQUENTIAL);
+        reader->data = (const char *)data;
+    }
+
+    return reader;
+}
+
+void pgn_close(PgnReader *reader)
+{
+    if (reader == NULL)
+        return;
+
+    if (reader->data != NULL)
+        munmap((void *)reader->data, reader->size);
+    close(reader->fd);
+    free(reader);
+}
+
+// Copies a tag value into a fixed-size field, truncating if necessary
+static void copy_tag(char *field, size_t field_size, const char *value, size_t length)
+{
+    if (length >= field_size)
+        length = field_size - 1;
+    memcpy(field, value, length);
+    field[length] = '\0';
+}
+
+// Parses a single "[Name "Value"]" line starting at c, returns the first character after it
+static const char *parse_tag(const char *c, const char *end, PgnTags *tags)
+{
+    c++; // skip '['
+    const char *name = c;
+    while (c < end && *c != ' ' && *c != ']' && *c != '\n')
+        c++;
+    size_t name_length = c - name;
+
+    while (c < end && *c == ' ')
+        c++;
+
+    char value[128];
+    size_t length = 0;
+    if (c < end && *c == '"')
+    {
+        c++;
+        while (c < end && *c != '"' && *c != '\n')
+        {
+            if (*c == '\\' && c + 1 < end)
+                c++;
+            if (length < sizeof(value) - 1)
+                value[length++] = *c;
+            c++;
+        }
+    }
+
+    // skip the rest of the line
+    while (c < end && *c != '\n')
+        c++;
+
+    struct
+    {
+        const char *name;
+        char *field;
+        size_t size;
+    } known[] = {
+        {"Event", tags->event, sizeof(tags->event)},
+        {"Site", tags->site, sizeof(tags->site)},
+        {"Date", tags->date, sizeof(tags->date)},
+        {"Round", tags->round, sizeof(tags->round)},
+        {"White", tags->white, sizeof(tags->white)},
+        {"Black", tags->black, sizeof(tags->black)},
+        {"Result", tags->result, sizeof(tags->result)},
+        {"FEN", tags->fen, sizeof(tags->fen)},
+    };
+
+    for (size_t i = 0; i < sizeof(known) / sizeof(known[0]); i++)
+    {
+        if (strlen(known[i].name) == name_length && strncmp(known[i].name, name, name_length) == 0)
+        {
+            copy_tag(known[i].field, known[i].size, value, length);
+            break;
+        }
+    }
+
+    return c;
+}
+
+// Reads the tag section of the next game and locates its movetext.
+// Moves are not parsed here, see pgn_next_move. Returns 1 if a game was found, 0 at end of file.
+int pgn_next_game(PgnReader *reader, PgnGame *pgn_game)
+{
+    if (reader == NULL || reader->data == NULL)
+        return 0;
+
+    const char *c = reader->data + reader->offset;
+    const char *end = reader->data + reader->size;
+
+    memset(&pgn_game->tags, 0, sizeof(PgnTags));
+
+    // Tag pairs
+    while (c < end)
+    {
+        while (c < end && isspace((unsigned char)*c))
+            c++;
+        if (c < end && *c == '[')
+            c = parse_tag(c, end, &pgn_game->tags);
+        else
+            break;
+    }
+    if (c >= end)
+    {
+        reader->offset = reader->size;
+        return 0;
+    }
+
+    // Movetext runs until the next tag line that isn't inside a comment
+    pgn_game->cursor = c;
+    int in_comment = 0;
+    int line_start = 0;
+    while (c < end)
+    {
+        if (in_comment)
+        {
+            if (*c == '}')
+                in_comment = 0;
+        }
+        else if (*c == '{')
+        {
+            in_comment = 1;
+        }
+        else if (*c == '[' && line_start)
+        {
+            break;
+        }
+        line_start = (*c == '\n');
+        c++;
+    }
+    pgn_game->end = c;
+    reader->offset = c - reader->data;
+
+    return 1;
+}
+
+// Sets up the starting position of a game: the FEN tag if there is one, otherwise the initial position
+int pgn_start_position(const PgnGame *pgn_game, Game *game)
+{
+    game->book = NULL;
+    game->bitbases = NULL;
+
+    if (pgn_game->tags.fen[0] != '\0')
+        return load_fen(game, pgn_game->tags.fen);
+
+    initialize_board(game);
+    return 1;
+}
+
+// Pseudo-legal targets of the piece on start_position, for the side to move
+static Bitboard piece_targets(Game *game, char piece, int start_position)
+{
+    switch (toupper(piece))
+    {
+    case 'P':
+        return calculate_pawn_moves(game, start_position, 0);
+    case 'N':
+        return calculate_knight_moves(game, start_position, 0);
+    case 'B':
+        return calculate_bishop_moves(game, start_position, 0);
+    case 'R':
+        return calculate_rook_moves(game, start_position, 0);
+    case 'Q':
+        return calculate_queen_moves(game, start_position, 0);
+    case 'K':
+        return calculate_king_moves(game, start_position);
+    }
+    return 0;
+}
+
+// Turns a SAN token (e.g. "Nbd7", "exd8=Q+", "O-O") into a move for the side to move.
+// Only the candidates of the named piece type are examined, and each must leave its own king
+// out of check, so an illegal move fails to resolve.
+static int san_to_move(Game *game, const char *san, int length, Move *m)
+{
+    // Strip check, mate and annotation suffixes
+    while (length > 0 && strchr("+#!?", san[length - 1]))
+        length--;
+    if (length < 2)
+        return 0;
+
+    int white = game->is_white_turn;
+
+    // Castling (letter O or digit zero)
+    if ((san[0] == 'O' || san[0] == '0') && length >= 3 && san[1] == '-')
+    {
+        Bitboard king = game->board.pieces[white][KING];
+        int origin = Bitboard_to_position(king);
+        int target = origin + (length >= 5 ? -2 : 2);
+        if (target < 0 || target >= 64)
+            return 0;
+        if (!(calculate_king_moves(game, origin) & position_to_Bitboard(target)))
+            return 0;
+
+        m->origin = origin;
+        m->target = target;
+        m->captured = '.';
+        m->promotion_piece = '.';
+        return 1;
+    }
+
+    char piece = 'P';
+    int i = 0;
+    if (strchr("NBRQK", san[0]))
+        piece = san[i++];
+
+    // Promotion, either "e8=Q" or "e8Q"
+    char promotion_piece = '.';
+    if (length >= 2 && strchr("NBRQ", san[length - 1]) && piece == 'P')
+    {
+        promotion_piece = san[length - 1];
+        length -= san[length - 2] == '=' ? 2 : 1;
+    }
+
+    // Remaining characters are [file][rank][x]file rank
+    int files[3], ranks[3];
+    int num_files = 0, num_ranks = 0;
+    for (; i < length; i++)
+    {
+        char c = san[i];
+        if (c >= 'a' && c <= 'h' && num_files < 3)
+            files[num_files++] = c - 'a';
+        else if (c >= '1' && c <= '8' && num_ranks < 3)
+            ranks[num_ranks++] = c - '1';
+        else if (c != 'x' && c != '-' && c != ':')
+            return 0;
+    }
+    if (num_files == 0 || num_ranks == 0)
+        return 0;
+
+    int target_file = files[num_files - 1];
+    int target_rank = ranks[num_ranks - 1];
+    int from_file = num_files > 1 ? files[0] : -1;
+    int from_rank = num_ranks > 1 ? ranks[0] : -1;
+
+    int target = (7 - target_rank) * 8 + target_file;
+    Bitboard target_bb = position_to_Bitboard(target);
+
+    if (!white)
+    {
+        piece = tolower(piece);
+        promotion_piece = tolower(promotion_piece);
+    }
+
+    // Collect candidate origins
+    int candidates[16];
+    int num_candidates = 0;
+    Bitboard pieces = *piece_bitboard(&game->board, piece);
+    while (pieces && num_candidates < 16)
+    {
+        int origin = get_and_clear_LSB(&pieces);
+        if (from_file != -1 && origin % 8 != from_file)
+            continue;
+        if (from_rank != -1 && 7 - origin / 8 != from_rank)
+            continue;
+        if (piece_targets(game, piece, origin) & target_bb)
+            candidates[num_candidates++] = origin;
+    }
+
+    // Even a single candidate may be pinned or walk its king into check
+    int origin = -1;
+    for (int j = 0; j < num_candidates; j++)
+    {
+        if (is_move_legal(game, candidates[j], target))
+        {
+            origin = candidates[j];
+            break;
+        }
+    }
+    if (origin == -1)
+        return 0;
+
+    // A pawn reaching the last rank has to promote, default to a queen
+    if ((piece == 'P' || piece == 'p') && (target_rank == 0 || target_rank == 7) && promotion_piece == '.')
+        promotion_piece = white ? 'Q' : 'q';
+
+    m->origin = origin;
+    m->target = target;
+    m->captured = get_piece_at_position(&game->board, target);
+    if ((piece == 'P' || piece == 'p') && m->captured == '.' && origin % 8 != target % 8)
+        m->captured = white ? 'p' : 'P'; // en passant
+    m->promotion_piece = promotion_piece;
+    m->next = NULL;
+    m->prev = NULL;
+    return 1;
+}
+
+// Plays the next move of the game on the board.
+// Returns 1 if a move was played, 0 at the end of the game, -1 on an unreadable or illegal move.
+int pgn_next_move(PgnGame *pgn_game, Game *game, Move *played)
+{
+    const char *c = pgn_game->cursor;
+    const char *end = pgn_game->end;
+
+    while (c < end)
+    {
+        if (isspace((unsigned char)*c))
+        {
+            c++;
+        }
+        else if (*c == '{')
+        {
+            // comment
+            while (c < end && *c != '}')
+                c++;
+            c++;
+        }
+        else if (*c == ';' || *c == '%')
+        {
+            // rest-of-line comment or escape line
+            while (c < end && *c != '\n')
+                c++;
+        }
+        else if (*c == '(')
+        {
+            // variation, possibly nested
+            int depth = 0;
+            for (; c < end; c++)
+            {
+                if (*c == '{')
+                {
+                    while (c < end && *c != '}')
+                        c++;
+                }
+                else if (*c == '(')
+                    depth++;
+                else if (*c == ')' && --depth == 0)
+                    break;
+            }
+            c++;
+        }
+        else if (*c == '$' || *c == '.' || *c == ')')
+        {
+            // numeric annotation glyph or stray punctuation
+            c++;
+            while (c < end && isdigit((unsigned char)*c))
+                c++;
+        }
+        else if (*c == '*')
+        {
+            break;
+        }
+        else if (isdigit((unsigned char)*c) && !(c + 2 < end && c[0] == '0' && c[1] == '-' && c[2] == '0'))
+        {
+            // move number ("12." / "12...") or game result ("1-0", "0-1", "1/2-1/2")
+            while (c < end && isdigit((unsigned char)*c))
+                c++;
+            if (c < end && (*c == '-' || *c == '/'))
+                break;
+        }
+        else
+        {
+            const char *token = c;
+            while (c < end && !isspace((unsigned char)*c) && !strchr("(){};", *c))
+                c++;
+            pgn_game->cursor = c;
+
+            Move m;
+            if (!san_to_move(game, token, (int)(c - token), &m))
+                return -1;
+
+            play_move(game, m.origin, m.target, m.promotion_piece);
+            if (played != NULL)
+                *played = m;
+            return 1;
+        }
+    }
+
+    pgn_game->cursor = end;
+    return 0;
+}
+
+// Writes the Standard Algebraic Notation of a legal move in the given position into san
+// (at least 10 characters). Returns the length of the string, 0 if there is no piece to move.
+int move_to_san(Game *game, const Move *m, char *san)
+{
+    char piece = get_piece_at_position(&game->board, m->origin);
+    if (piece == '.')
+        return 0;
+
+    int origin = m->origin;
+    int target = m->target;
+    char upper = toupper(piece);
+    int length = 0;
+
+    if (upper == 'K' && abs((target % 8) - (origin % 8)) == 2)
+    {
+        length = sprintf(san, (target % 8) > (origin % 8) ? "O-O" : "O-O-O");
+    }
+    else
+    {
+        int capture = get_piece_at_position(&game->board, m->target) != '.' ||
+                      (upper == 'P' && target % 8 != origin % 8);
+
+        if (upper == 'P')
+        {
+            if (capture)
+                san[length++] = 'a' + origin % 8;
+        }
+        else
+        {
+            san[length++] = upper;
+
+            // Disambiguate between identical pieces that can reach the same square
+            Move legal[MAX_MOVES];
+            int count = generate_legal_moves(game, game->is_white_turn, legal);
+            int ambiguous = 0, same_file = 0, same_rank = 0;
+            for (int i = 0; i < count; i++)
+            {
+                if (legal[i].target != m->target || legal[i].origin == m->origin ||
+                    get_piece_at_position(&game->board, legal[i].origin) != piece)
+                    continue;
+
+                int other = legal[i].origin;
+                ambiguous = 1;
+                if (other % 8 == origin % 8)
+                    same_file = 1;
+                if (other / 8 == origin / 8)
+                    same_rank = 1;
+            }
+            if (ambiguous && (!same_file || same_rank))
+                san[length++] = 'a' + origin % 8;
+            if (ambiguous && same_file)
+                san[length++] = '8' - origin / 8;
+        }
+
+        if (capture)
+            san[length++] = 'x';
+        san[length++] = 'a' + target % 8;
+        san[length++] = '8' - target / 8;
+
+        if (m->promotion_piece != '.')
+        {
+            san[length++] = '=';
+            san[length++] = toupper(m->promotion_piece);
+        }
+    }
+
+    // Check or checkmate
+    Game temp_game;
+    memcpy(&temp_game, game, sizeof(Game));
+    play_move(&temp_game, m->origin, m->target, m->promotion_piece);
+
+    int in_check = temp_game.isCheck == 10 ||
+                   (temp_game.is_white_turn ? temp_game.isCheck == 1 : temp_game.isCheck == 2);
+    if (in_check)
+    {
+        san[length++] = has_legal_move(&temp_game) ? '+' : '#';
+    }
+
+    san[length] = '\0';
+    return length;
+}
+
+// PGN result string for the current state of the game
+const char *pgn_result(const Game *game)
+{
+    switch (game->isCheck)
+    {
+    case 0:
+        return "1/2-1/2";
+    case 3:
+        return "0-1";
+    case 4:
+        return "1-0";
+    }
+    return "*";
+}
+
+// Writes one game in PGN export format. start is the position the moves are played from
+// (NULL for the initial position). Returns 1 on success, 0 if a move could not be replayed.
+int pgn_write_game(FILE *out, const Game *start, const MoveList *moves, const PgnTags *tags)
+{
+    Game game;
+    if (start != NULL)
+    {
+        memcpy(&game, start, sizeof(Game));
+    }
+    else
+    {
+        memset(&game, 0, sizeof(Game));
+        initialize_board(&game);
+    }
+
+    const char *result = tags->result[0] != '\0' ? tags->result : "*";
+
+    fprintf(out, "[Event \"%s\"]\n", tags->event[0] != '\0' ? tags->event : "?");
+    fprintf(out, "[Site \"%s\"]\n", tags->site[0] != '\0' ? tags->site : "?");
+    fprintf(out, "[Date \"%s\"]\n", tags->date[0] != '\0' ? tags->date : "????.??.??");
+    fprintf(out, "[Round \"%s\"]\n", tags->round[0] != '\0' ? tags->round : "?");
+    fprintf(out, "[White \"%s\"]\n", tags->white[0] != '\0' ? tags->white : "?");
+    fprintf(out, "[Black \"%s\"]\n", tags->black[0] != '\0' ? tags->black : "?");
+    fprintf(out, "[Result \"%s\"]\n", result);
+    if (tags->fen[0] != '\0')
+    {
+        fprintf(out, "[SetUp \"1\"]\n");
+        fprintf(out, "[FEN \"%s\"]\n", tags->fen);
+    }
+    fprintf(out, "\n");
+
+    // Movetext, wrapped before 80 columns
+    int column = 0;
+    int move_number = 1;
+    int first = 1;
+    int success = 1;
+    char token[32];
+
+    for (Move *current = moves != NULL ? moves->head : NULL; current != NULL; current = current->next)
+    {
+        char san[16];
+        if (!move_to_san(&game, current, san))
+        {
+            printf("ERROR: unable to replay move %d for PGN export\n", move_number);
+            success = 0;
+            break;
+        }
+
+        int length;
+        if (game.is_white_turn)
+            length = snprintf(token, sizeof(token), "%d. %s", move_number, san);
+        else if (first)
+            length = snprintf(token, sizeof(token), "%d... %s", move_number, san);
+        else
+            length = snprintf(token, sizeof(token), "%s", san);
+
+        if (column > 0 && column + 1 + length > 79)
+        {
+            fprintf(out, "\n");
+            column = 0;
+        }
+        column += fprintf(out, column > 0 ? " %s" : "%s", token);
+
+        if (!game.is_white_turn)
+            move_number++;
+        first = 0;
+        play_move(&game, current->origin, current->target, current->promotion_piece);
+    }
+
+    if (column > 0 && column + 1 + (int)strlen(result) > 79)
+        fprintf(out, "\n");
+    else if (column > 0)
+        fprintf(out, " ");
+    fprintf(out, "%s\n\n", result);
+
+    return success;
+}
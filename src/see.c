@@ -0,0 +1,73 @@
+#include "chessEngine.h"
+
+// Static exchange evaluation: the material a move wins or loses once every piece that
+// attacks the target square has joined in, each side recapturing with its least valuable
+// attacker and stopping whenever going on would lose more. No moves are made; the pieces
+// are taken out of an occupancy bitboard, which uncovers sliders behind them (x-rays).
+
+// Material the side making m wins, in centipawns (negative if the exchange loses).
+// Works for quiet moves too: moving a piece onto a square the opponent wins it on is negative.
+int see(const ChessBoard *board, const Move *m)
+{
+    int piece = board->squares[m->origin];
+    if (piece == EMPTY)
+        return 0;
+
+    int target = m->target;
+    int victim = board->squares[target];
+    int side = PIECE_COLOR(piece);
+    Bitboard occupied = (board->occupied[WHITE] | board->occupied[BLACK]) ^ position_to_Bitboard(m->origin);
+
+    int gain[32];
+    gain[0] = victim == EMPTY ? 0 : piece_values[PIECE_TYPE(victim)];
+    int on_square = piece_values[PIECE_TYPE(piece)]; // value of the piece standing on target
+
+    if (PIECE_TYPE(piece) == PAWN && victim == EMPTY && m->origin % 8 != target % 8)
+    {
+        // en passant: the captured pawn stands beside the origin
+        gain[0] = piece_values[PAWN];
+        occupied ^= position_to_Bitboard(m->origin - m->origin % 8 + target % 8);
+    }
+    if (m->promotion_piece != '.')
+    {
+        int promoted = PIECE_TYPE(piece_code(m->promotion_piece));
+        gain[0] += piece_values[promoted] - piece_values[PAWN];
+        on_square = piece_values[promoted];
+    }
+
+    Bitboard attackers = all_attackers_to(board, target, occupied);
+    int depth = 0;
+    while (depth < 31)
+    {
+        // what the other side wins if it takes the piece on the square
+        depth++;
+        gain[depth] = on_square - gain[depth - 1];
+
+        side = !side;
+        Bitboard own = attackers & board->occupied[side];
+        if (own == 0)
+            break;
+
+        // least valuable attacker
+        int type = PAWN;
+        while (!(own & board->pieces[side][type]))
+            type++;
+
+        // the king may only take last, when nothing defends the square any more
+        if (type == KING && (attackers & board->occupied[!side]))
+            break;
+
+        on_square = piece_values[type];
+        Bitboard from = own & board->pieces[side][type];
+        occupied ^= from & -from;
+        attackers = all_attackers_to(board, target, occupied);
+    }
+
+    // The last entry is speculative, there was no capture to make it. Going back, either
+    // side may stop capturing when that is better for it.
+    while (--depth > 0)
+    {
+        gain[depth - 1] = -max(-gain[depth - 1], gain[depth]);
+    }
+    return gain[0];
+}
@@ -0,0 +1,606 @@
+#include "chessEngine.h"
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Analysis daemon ("main serve"). Clients connect to a Unix domain socket and send one
+// JSON request per line, any number of them without waiting for the answers:
+//   {"id": "7", "fen": "<fen>", "depth": 8, "nodes": 1000000, "movetime": 500, "deadline": 2000, "multipv": 3}
+// Only fen is required. deadline is in milliseconds from arrival: a request still queued
+// by then is dropped, a running search is stopped and answered with what it has.
+// With multipv above 1, info and bestmove also carry the best root moves ranked by score:
+//   ..."lines":[{"score":"cp 30","pv":["e2e4","e7e5"]},{"score":"cp 25","pv":["d2d4"]}]}
+// Answers are streamed back as JSON lines, an "info" after every completed iteration and
+// then a single "bestmove" or "error":
+//   {"id":"7","type":"info","depth":5,"score":"cp 35","nodes":80512,"time":210,"pv":["e2e4","e7e5"]}
+//   {"id":"7","type":"bestmove","move":"e2e4","depth":6,"score":"cp 30","nodes":312001,"time":812,"pv":[...]}
+// Every client has its own queue and the workers take requests round-robin over the
+// clients, so one client sending a large batch can't starve the others.
+
+#define SERVE_MAX_LINE 4096
+#define SERVE_DEFAULT_DEPTH 4 // plies, when a request sets no limit at all
+#define SERVE_SEND_TIMEOUT 2  // seconds a client may stall a write before it's dropped
+
+typedef struct ServeRequest
+{
+    char id[64];
+    char fen[100];
+    SearchLimits limits;
+    long long deadline; // current_time_ms() at which to give up, 0 for none
+    int multi_pv;       // root moves to rank, 0 or 1 for just the best
+    struct ServeRequest *next;
+} ServeRequest;
+
+typedef struct ServeClient
+{
+    int fd;
+    int references;   // the server's client list plus every worker answering one of its requests
+    int disconnected; // nothing is sent any more, queued requests are dropped
+    pthread_mutex_t write_lock; // guards disconnected and the writes
+    ServeRequest *queue_head;
+    ServeRequest *queue_tail;
+    char buffer[SERVE_MAX_LINE]; // unfinished request line
+    size_t buffered;
+    struct ServeClient *next;
+} ServeClient;
+
+struct Server;
+
+typedef struct
+{
+    pthread_t thread;
+    struct Server *server;
+    TranspositionTable *tt; // kept for the worker's lifetime
+    SearchContext context;
+    ServeRequest request; // request being answered
+    ServeClient *client;  // its client, NULL while idle
+    Game root;
+} ServeWorker;
+
+typedef struct Server
+{
+    pthread_mutex_t lock; // guards the client list, the queues and every worker's client
+    pthread_cond_t work_ready;
+    ServeClient *clients;
+    ServeClient *next_client; // where the round-robin continues
+    int num_queued;
+    int stopping;
+    ServeWorker *workers;
+    int num_workers;
+    AnalysisCache *cache; // shared by the workers, it needs no lock
+} Server;
+
+static volatile sig_atomic_t serve_interrupted = 0;
+
+static void handle_interrupt(int signal_number)
+{
+    (void)signal_number;
+    serve_interrupted = 1;
+}
+
+// Finds "key": in a flat JSON object and returns the start of its value, NULL if missing
+static const char *json_find(const char *line, const char *key)
+{
+    char pattern[64];
+    snprintf(pattern, sizeof(pattern), "\"%s\"", key);
+    const char *c = strstr(line, pattern);
+    if (c == NULL)
+        return NULL;
+
+    c += strlen(pattern);
+    while (*c == ' ' || *c == '\t')
+        c++;
+    if (*c != ':')
+        return NULL;
+    c++;
+    while (*c == ' ' || *c == '\t')
+        c++;
+    return c;
+}
+
+static int json_string(const char *line, const char *key, char *out, size_t size)
+{
+    const char *c = json_find(line, key);
+    if (c == NULL || *c != '"')
+        return 0;
+
+    size_t length = 0;
+    for (c++; *c != '\0' && *c != '"' && length + 1 < size; c++)
+    {
+        if (*c == '\\' && c[1] != '\0')
+            c++;
+        out[length++] = *c;
+    }
+    out[length] = '\0';
+    return *c == '"';
+}
+
+static int json_number(const char *line, const char *key, long long *out)
+{
+    const char *c = json_find(line, key);
+    if (c == NULL)
+        return 0;
+
+    char *end;
+    long long value = strtoll(c, &end, 10);
+    if (end == c)
+        return 0;
+    *out = value;
+    return 1;
+}
+
+// Copies text into out with quotes and backslashes escaped
+static void json_escape(const char *text, char *out, size_t size)
+{
+    size_t length = 0;
+    for (; *text != '\0' && length + 2 < size; text++)
+    {
+        if (*text == '"' || *text == '\\')
+            out[length++] = '\\';
+        out[length++] = (*text >= ' ') ? *text : ' ';
+    }
+    out[length] = '\0';
+}
+
+// Writes one line to the client unless it has gone away. A client that doesn't read
+// within SERVE_SEND_TIMEOUT is shut down, the poll loop then sees it hang up and drops it.
+static void serve_send(ServeClient *client, const char *format, ...)
+{
+    char line[SERVE_MAX_LINE];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(line, sizeof(line) - 1, format, args);
+    va_end(args);
+    if (length < 0)
+        return;
+    length = min(length, (int)sizeof(line) - 2);
+    line[length++] = '\n';
+
+    pthread_mutex_lock(&client->write_lock);
+    for (int written = 0; written < length && !client->disconnected;)
+    {
+        ssize_t result = write(client->fd, line + written, length - written);
+        if (result < 0 && errno == EINTR)
+            continue;
+        if (result <= 0)
+        {
+            client->disconnected = 1;
+            shutdown(client->fd, SHUT_RDWR);
+            break;
+        }
+        written += (int)result;
+    }
+    pthread_mutex_unlock(&client->write_lock);
+}
+
+// Drops a reference; the last one closes the connection. Called with server->lock held.
+static void release_client(ServeClient *client)
+{
+    if (--client->references > 0)
+        return;
+
+    close(client->fd);
+    pthread_mutex_destroy(&client->write_lock);
+    free(client);
+}
+
+// Writes the line as a JSON array of UCI moves
+static void format_pv(const SearchResult *line, char *out)
+{
+    char *c = out;
+    *c++ = '[';
+    for (int i = 0; i < line->length; i++)
+    {
+        c += sprintf(c, i > 0 ? ",\"" : "\"");
+        move_to_uci(&line->moves[i], c);
+        c += strlen(c);
+        *c++ = '"';
+    }
+    *c++ = ']';
+    *c = '\0';
+}
+
+// Writes ,"lines":[...] with the multi-PV lines, best first, as many as fit in size bytes.
+// Writes nothing for a single line.
+static void format_lines(const Game *root, const SearchContext *context, char *out, size_t size)
+{
+    *out = '\0';
+    if (context->num_pv_lines <= 1)
+        return;
+
+    char score[32], pv[MAX_SEARCH_DEPTH * 8 + 3];
+    size_t length = (size_t)sprintf(out, ",\"lines\":[");
+    for (int i = 0; i < context->num_pv_lines; i++)
+    {
+        format_uci_score(root, &context->pv_lines[i], score);
+        format_pv(&context->pv_lines[i], pv);
+        if (length + strlen(score) + strlen(pv) + 24 >= size)
+            break;
+        length += (size_t)sprintf(out + length, "%s{\"score\":\"%s\",\"pv\":%s}", i > 0 ? "," : "", score, pv);
+    }
+    sprintf(out + length, "]");
+}
+
+static void report_iteration(const SearchContext *context, void *user_data)
+{
+    ServeWorker *worker = (ServeWorker *)user_data;
+    char id[128], score[32], pv[MAX_SEARCH_DEPTH * 8 + 3], lines[SERVE_MAX_LINE / 2];
+
+    json_escape(worker->request.id, id, sizeof(id));
+    format_uci_score(&worker->root, &context->best_line, score);
+    format_pv(&context->best_line, pv);
+    format_lines(&worker->root, context, lines, sizeof(lines));
+    serve_send(worker->client, "{\"id\":\"%s\",\"type\":\"info\",\"depth\":%d,\"score\":\"%s\",\"nodes\":%lld,\"time\":%lld,\"pv\":%s%s}",
+               id, context->depth_reached, score, context->positions_counted,
+               current_time_ms() - context->start_time, pv, lines);
+}
+
+static void answer_request(ServeWorker *worker)
+{
+    ServeRequest *request = &worker->request;
+    ServeClient *client = worker->client;
+    SearchContext *context = &worker->context;
+    char id[128];
+    json_escape(request->id, id, sizeof(id));
+
+    long long now = current_time_ms();
+    if (request->deadline > 0 && now >= request->deadline)
+    {
+        serve_send(client, "{\"id\":\"%s\",\"type\":\"error\",\"message\":\"deadline passed while queued\"}", id);
+        return;
+    }
+
+    memset(&worker->root, 0, sizeof(Game));
+    if (!load_fen(&worker->root, request->fen))
+    {
+        serve_send(client, "{\"id\":\"%s\",\"type\":\"error\",\"message\":\"invalid fen\"}", id);
+        return;
+    }
+
+    // The deadline caps the search time
+    if (request->deadline > 0)
+    {
+        long long remaining = request->deadline - now;
+        if (context->limits.move_time == 0 || context->limits.move_time > remaining)
+            context->limits.move_time = (int)remaining;
+    }
+
+    context->on_iteration = report_iteration;
+    context->user_data = worker;
+
+    Game game;
+    memcpy(&game, &worker->root, sizeof(Game));
+    Move best_move;
+    if (!search_position(&game, context, &best_move))
+    {
+        serve_send(client, "{\"id\":\"%s\",\"type\":\"error\",\"message\":\"no legal moves\"}", id);
+        return;
+    }
+
+    char move_text[8], score[32], pv[MAX_SEARCH_DEPTH * 8 + 3], lines[SERVE_MAX_LINE / 2];
+    move_to_uci(&best_move, move_text);
+    format_uci_score(&worker->root, &context->best_line, score);
+    format_pv(&context->best_line, pv);
+    format_lines(&worker->root, context, lines, sizeof(lines));
+    serve_send(client, "{\"id\":\"%s\",\"type\":\"bestmove\",\"move\":\"%s\",\"depth\":%d,\"score\":\"%s\",\"nodes\":%lld,\"time\":%lld,\"pv\":%s%s}",
+               id, move_text, context->depth_reached, score, context->positions_counted,
+               current_time_ms() - context->start_time, pv, lines);
+}
+
+// Takes the next request, continuing the round-robin over the clients. Called with server->lock held.
+static ServeClient *next_request(Server *server, ServeRequest *out)
+{
+    int num_clients = 0;
+    for (ServeClient *client = server->clients; client != NULL; client = client->next)
+        num_clients++;
+
+    ServeClient *client = server->next_client;
+    for (int i = 0; i < num_clients; i++, client = client->next)
+    {
+        if (client == NULL)
+            client = server->clients;
+        if (client->queue_head != NULL)
+        {
+            ServeRequest *request = client->queue_head;
+            client->queue_head = request->next;
+            if (client->queue_head == NULL)
+                client->queue_tail = NULL;
+            server->num_queued--;
+            server->next_client = client->next;
+
+            *out = *request;
+            free(request);
+            return client;
+        }
+    }
+    return NULL;
+}
+
+static void *serve_worker(void *argument)
+{
+    ServeWorker *worker = (ServeWorker *)argument;
+    Server *server = worker->server;
+
+    pthread_mutex_lock(&server->lock);
+    while (1)
+    {
+        while (!server->stopping && server->num_queued == 0)
+            pthread_cond_wait(&server->work_ready, &server->lock);
+        if (server->stopping)
+            break;
+
+        ServeClient *client = next_request(server, &worker->request);
+        if (client == NULL)
+            continue;
+        client->references++;
+        worker->client = client;
+        memset(&worker->context, 0, sizeof(SearchContext));
+        worker->context.limits = worker->request.limits;
+        worker->context.params.futility_margin = DEFAULT_FUTILITY_MARGIN;
+        worker->context.params.razor_margin = DEFAULT_RAZOR_MARGIN;
+        worker->context.tt = worker->tt;
+        worker->context.cache = server->cache;
+        worker->context.multi_pv = worker->request.multi_pv;
+        pthread_mutex_unlock(&server->lock);
+
+        answer_request(worker);
+
+        pthread_mutex_lock(&server->lock);
+        worker->client = NULL;
+        release_client(client);
+    }
+    pthread_mutex_unlock(&server->lock);
+    return NULL;
+}
+
+// Parses one request line and queues it. Called without server->lock, errors are answered directly.
+static void queue_request(Server *server, ServeClient *client, const char *line)
+{
+    ServeRequest *request = (ServeRequest *)calloc(1, sizeof(ServeRequest));
+    if (request == NULL)
+    {
+        printf("ERROR: Failed to create request\n");
+        return;
+    }
+
+    json_string(line, "id", request->id, sizeof(request->id));
+    if (!json_string(line, "fen", request->fen, sizeof(request->fen)))
+    {
+        char id[128];
+        json_escape(request->id, id, sizeof(id));
+        serve_send(client, "{\"id\":\"%s\",\"type\":\"error\",\"message\":\"missing fen\"}", id);
+        free(request);
+        return;
+    }
+
+    long long value;
+    if (json_number(line, "depth", &value))
+        request->limits.depth = (int)value;
+    if (json_number(line, "nodes", &value))
+        request->limits.nodes = value;
+    if (json_number(line, "movetime", &value))
+        request->limits.move_time = (int)value;
+    if (json_number(line, "deadline", &value) && value > 0)
+        request->deadline = current_time_ms() + value;
+    if (json_number(line, "multipv", &value))
+        request->multi_pv = value < 1 ? 1 : value > MAX_MULTI_PV ? MAX_MULTI_PV : (int)value;
+    if (request->limits.depth == 0 && request->limits.nodes == 0 &&
+        request->limits.move_time == 0 && request->deadline == 0)
+        request->limits.depth = SERVE_DEFAULT_DEPTH;
+
+    pthread_mutex_lock(&server->lock);
+    if (client->queue_tail != NULL)
+        client->queue_tail->next = request;
+    else
+        client->queue_head = request;
+    client->queue_tail = request;
+    server->num_queued++;
+    pthread_cond_signal(&server->work_ready);
+    pthread_mutex_unlock(&server->lock);
+}
+
+// Removes a client: its queued requests are dropped and searches for it are stopped.
+// Called with server->lock held.
+static void disconnect_client(Server *server, ServeClient *client)
+{
+    pthread_mutex_lock(&client->write_lock);
+    client->disconnected = 1;
+    pthread_mutex_unlock(&client->write_lock);
+
+    while (client->queue_head != NULL)
+    {
+        ServeRequest *request = client->queue_head;
+        client->queue_head = request->next;
+        free(request);
+        server->num_queued--;
+    }
+    client->queue_tail = NULL;
+
+    for (int i = 0; i < server->num_workers; i++)
+    {
+        if (server->workers[i].client == client)
+            server->workers[i].context.stop = 1;
+    }
+
+    ServeClient **link = &server->clients;
+    while (*link != client)
+        link = &(*link)->next;
+    *link = client->next;
+    if (server->next_client == client)
+        server->next_client = client->next;
+
+    release_client(client);
+}
+
+// Reads what the client sent and queues every complete line. Returns 0 once the client has gone.
+// Only the polling thread reads, so the line buffer needs no lock.
+static int read_client(Server *server, ServeClient *client)
+{
+    ssize_t received = read(client->fd, client->buffer + client->buffered, sizeof(client->buffer) - client->buffered - 1);
+    if (received <= 0)
+        return 0;
+    client->buffered += received;
+    client->buffer[client->buffered] = '\0';
+
+    char *line = client->buffer;
+    char *end;
+    while ((end = strchr(line, '\n')) != NULL)
+    {
+        *end = '\0';
+        if (strchr(line, '{') != NULL)
+            queue_request(server, client, line);
+        line = end + 1;
+    }
+
+    client->buffered -= line - client->buffer;
+    memmove(client->buffer, line, client->buffered);
+    if (client->buffered == sizeof(client->buffer) - 1)
+    {
+        serve_send(client, "{\"type\":\"error\",\"message\":\"request too long\"}");
+        client->buffered = 0;
+    }
+    return 1;
+}
+
+// Serves until SIGINT/SIGTERM. The optional cache is shared by all workers.
+int run_server(const char *socket_path, int num_workers, int hash_size, AnalysisCache *cache)
+{
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(address.sun_path))
+    {
+        printf("ERROR: socket path %s is too long\n", socket_path);
+        return 0;
+    }
+    strcpy(address.sun_path, socket_path);
+
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(socket_path);
+    if (listen_fd < 0 || bind(listen_fd, (struct sockaddr *)&address, sizeof(address)) < 0 || listen(listen_fd, 64) < 0)
+    {
+        printf("ERROR: unable to listen on %s\n", socket_path);
+        if (listen_fd >= 0)
+            close(listen_fd);
+        return 0;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, handle_interrupt);
+    signal(SIGTERM, handle_interrupt);
+
+    Server server;
+    memset(&server, 0, sizeof(Server));
+    pthread_mutex_init(&server.lock, NULL);
+    pthread_cond_init(&server.work_ready, NULL);
+    server.num_workers = num_workers;
+    server.cache = cache;
+    server.workers = (ServeWorker *)calloc(num_workers, sizeof(ServeWorker));
+
+    // Tables are allocated once here, not per request
+    size_t huge_bytes = 0;
+    for (int i = 0; i < num_workers; i++)
+    {
+        server.workers[i].server = &server;
+        server.workers[i].tt = tt_create(hash_size);
+        if (server.workers[i].tt != NULL)
+            huge_bytes += server.workers[i].tt->huge_bytes;
+        pthread_create(&server.workers[i].thread, NULL, serve_worker, &server.workers[i]);
+    }
+    printf("Serving on %s with %d workers, %d MB hash each (%zu MB in huge pages)\n", socket_path, num_workers, hash_size,
+           huge_bytes >> 20);
+    fflush(stdout);
+
+    struct pollfd *fds = NULL;
+    ServeClient **polled = NULL;
+    int capacity = 0;
+
+    while (!serve_interrupted)
+    {
+        // Only this thread adds or removes clients, so the pointers stay valid during the poll
+        pthread_mutex_lock(&server.lock);
+        int count = 1;
+        for (ServeClient *client = server.clients; client != NULL; client = client->next)
+            count++;
+        if (count > capacity)
+        {
+            capacity = count * 2;
+            fds = (struct pollfd *)realloc(fds, capacity * sizeof(struct pollfd));
+            polled = (ServeClient **)realloc(polled, capacity * sizeof(ServeClient *));
+        }
+        fds[0].fd = listen_fd;
+        fds[0].events = POLLIN;
+        count = 1;
+        for (ServeClient *client = server.clients; client != NULL; client = client->next)
+        {
+            fds[count].fd = client->fd;
+            fds[count].events = POLLIN;
+            polled[count++] = client;
+        }
+        pthread_mutex_unlock(&server.lock);
+
+        if (poll(fds, count, 250) <= 0)
+            continue;
+
+        // Requests are read and errors answered without the lock, a slow client only delays this loop
+        for (int i = 1; i < count; i++)
+        {
+            if ((fds[i].revents & (POLLIN | POLLHUP | POLLERR)) && !read_client(&server, polled[i]))
+            {
+                pthread_mutex_lock(&server.lock);
+                disconnect_client(&server, polled[i]);
+                pthread_mutex_unlock(&server.lock);
+            }
+        }
+        if (fds[0].revents & POLLIN)
+        {
+            int fd = accept(listen_fd, NULL, NULL);
+            ServeClient *client = fd >= 0 ? (ServeClient *)calloc(1, sizeof(ServeClient)) : NULL;
+            if (client != NULL)
+            {
+                struct timeval timeout = {SERVE_SEND_TIMEOUT, 0};
+                setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+                client->fd = fd;
+                client->references = 1;
+                pthread_mutex_init(&client->write_lock, NULL);
+                pthread_mutex_lock(&server.lock);
+                client->next = server.clients;
+                server.clients = client;
+                pthread_mutex_unlock(&server.lock);
+            }
+            else if (fd >= 0)
+            {
+                close(fd);
+            }
+        }
+    }
+
+    printf("Shutting down\n");
+    pthread_mutex_lock(&server.lock);
+    server.stopping = 1;
+    while (server.clients != NULL)
+        disconnect_client(&server, server.clients);
+    pthread_cond_broadcast(&server.work_ready);
+    pthread_mutex_unlock(&server.lock);
+
+    for (int i = 0; i < num_workers; i++)
+    {
+        pthread_join(server.workers[i].thread, NULL);
+        tt_free(server.workers[i].tt);
+    }
+
+    close(listen_fd);
+    unlink(socket_path);
+    free(fds);
+    free(polled);
+    free(server.workers);
+    pthread_cond_destroy(&server.work_ready);
+    pthread_mutex_destroy(&server.lock);
+    return 1;
+}
@@ -1,5 +1,7 @@
 #include "a_header.h"
 
+SDL_Texture *piece_textures[12];
+
 void load_piece_textures(SDL_Renderer *renderer)
 {
     const char *piece_files[] = {"wp.svg", "wn.svg", "wb.svg", "wr.svg", "wq.svg", "wk.svg", "bp.svg", "bn.svg", "bb.svg", "br.svg", "bq.svg", "bk.svg"};
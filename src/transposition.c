@@ -0,0 +1,125 @@
+#include "chessEngine.h"
+
+// Transposition table: one entry per bucket, indexed by the low bits of the position key.
+// A table belongs to one search thread at a time, so it needs no locking.
+
+// Allocates a table of about size_mb megabytes (rounded down to a power of two entries),
+// zeroed up front and in huge pages where the system provides them
+TranspositionTable *tt_create(size_t size_mb)
+{
+    size_t num_entries = 1;
+    while (num_entries * 2 * sizeof(TTEntry) <= size_mb * 1024 * 1024)
+        num_entries *= 2;
+
+    TranspositionTable *tt = (TranspositionTable *)malloc(sizeof(TranspositionTable));
+    if (tt == NULL)
+    {
+        printf("ERROR: Failed to create transposition table\n");
+        return NULL;
+    }
+    tt->entries = (TTEntry *)large_alloc(num_entries * sizeof(TTEntry), &tt->huge_bytes);
+    if (tt->entries == NULL)
+    {
+        printf("ERROR: unable to allocate a %zu MB transposition table\n", size_mb);
+        free(tt);
+        return NULL;
+    }
+    tt->mask = num_entries - 1;
+    return tt;
+}
+
+void tt_free(TranspositionTable *tt)
+{
+    if (tt == NULL)
+        return;
+
+    large_free(tt->entries, (tt->mask + 1) * sizeof(TTEntry));
+    free(tt);
+}
+
+// Forgets every position, e.g. before a new game
+void tt_clear(TranspositionTable *tt)
+{
+    if (tt == NULL)
+        return;
+
+    memset(tt->entries, 0, (tt->mask + 1) * sizeof(TTEntry));
+}
+
+// Returns the entry stored for key, or NULL if there is none
+const TTEntry *tt_probe(const TranspositionTable *tt, uint64_t key)
+{
+    if (tt == NULL)
+        return NULL;
+
+    const TTEntry *entry = &tt->entries[key & tt->mask];
+    return (entry->key == key && entry->bound != TT_NONE) ? entry : NULL;
+}
+
+// Stores a search result; a deeper result for another position is only replaced by a deeper one
+void tt_store(TranspositionTable *tt, uint64_t key, int depth, int score, int bound, const Move *best_move)
+{
+    if (tt == NULL)
+        return;
+
+    TTEntry *entry = &tt->entries[key & tt->mask];
+    if (entry->key != key && entry->bound != TT_NONE && entry->depth > depth)
+        return;
+
+    entry->key = key;
+    entry->score = score;
+    entry->depth = (int8_t)depth;
+    entry->bound = (uint8_t)bound;
+    entry->move = tt_encode_move(best_move);
+}
+
+// Packs a move into 16 bits: origin | target << 6 | promotion << 12 (1-4 = n, b, r, q), 0 for none
+uint16_t tt_encode_move(const Move *m)
+{
+    if (m == NULL)
+        return 0;
+
+    int promotion = m->promotion_piece == '.' ? 0 : (int)(strchr("nbrq", tolower(m->promotion_piece)) - "nbrq") + 1;
+    return (uint16_t)(m->origin | m->target << 6 | promotion << 12);
+}
+
+// Puts the table's move for this position first in moves. Returns 1 if it was found.
+int tt_order_move(const TTEntry *entry, Move *moves, int count)
+{
+    if (entry == NULL || entry->move == 0)
+        return 0;
+
+    int origin = entry->move & 63;
+    int target = (entry->move >> 6) & 63;
+    int promotion = entry->move >> 12;
+
+    for (int i = 0; i < count; i++)
+    {
+        char piece = moves[i].promotion_piece == '.' ? 0 : tolower(moves[i].promotion_piece);
+        int move_promotion = piece == 0 ? 0 : (int)(strchr("nbrq", piece) - "nbrq") + 1;
+        if (moves[i].origin == origin && moves[i].target == target && move_promotion == promotion)
+        {
+            Move swap = moves[0];
+            moves[0] = moves[i];
+            moves[i] = swap;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Unpacks the entry's move for game (no legality check). Returns 0 if the entry has no move.
+int tt_decode_move(const TTEntry *entry, const Game *game, Move *m)
+{
+    if (entry == NULL || entry->move == 0)
+        return 0;
+
+    int promotion = entry->move >> 12;
+    m->origin = entry->move & 63;
+    m->target = (entry->move >> 6) & 63;
+    m->captured = get_piece_at_position(&game->board, m->target);
+    m->promotion_piece = promotion == 0 ? '.' : (game->is_white_turn ? "NBRQ" : "nbrq")[promotion - 1];
+    m->next = NULL;
+    m->prev = NULL;
+    return 1;
+}
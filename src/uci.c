@@ -0,0 +1,491 @@
+#include "chessEngine.h"
+#include <pthread.h>
+#include <stdarg.h>
+
+// Universal Chess Interface over stdin/stdout ("main uci"), so the engine can be
+// driven by match runners and chess GUIs. The search runs in its own thread so
+// that "stop" and "isready" are answered while it is thinking.
+
+typedef struct
+{
+    Game game;              // position of the last "position" command
+    SearchContext context;  // context of the running search
+    pthread_t thread;       // search thread, valid while searching is set
+    int searching;
+    OpeningBook *book;
+    Bitbases *bitbases;
+    int book_depth;
+    int book_best;
+    unsigned int random_seed; // for the book moves of the next position
+    TranspositionTable *tt;   // kept between searches, cleared by "ucinewgame"
+    AnalysisCache *cache;     // persistent analysis cache, NULL if none
+    int cache_size;
+    int cache_depth;
+    SearchParams params; // frontier pruning margins of the next searches
+    KeyHistory history;  // positions of the game before the current one
+    int multi_pv;        // best root moves reported with their lines
+    pthread_mutex_t hold_lock;
+    pthread_cond_t released;
+    int hold;        // "go infinite" or "go ponder": bestmove waits for "stop" or "ponderhit"
+    int ponder_time; // move time of a ponder search, applied from "ponderhit" on
+} UciEngine;
+
+static pthread_mutex_t output_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Writes one line to the GUI; info lines come from the search thread, everything else from the reader
+static void uci_send(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    pthread_mutex_lock(&output_lock);
+    vprintf(format, args);
+    printf("\n");
+    fflush(stdout);
+    pthread_mutex_unlock(&output_lock);
+    va_end(args);
+}
+
+// Long algebraic notation used by UCI: "e2e4", "e7e8q"
+void move_to_uci(const Move *m, char *text)
+{
+    char from[3], to[3];
+    position_to_notation(m->origin, from);
+    position_to_notation(m->target, to);
+    sprintf(text, "%s%s", from, to);
+    if (m->promotion_piece != '.')
+    {
+        text[4] = tolower(m->promotion_piece);
+        text[5] = '\0';
+    }
+}
+
+// Finds the legal move written as "e2e4" / "e7e8q". Returns 1 and fills out if found.
+int parse_uci_move(Game *game, const char *text, Move *out)
+{
+    if (strlen(text) < 4 || text[0] < 'a' || text[0] > 'h' || text[2] < 'a' || text[2] > 'h' ||
+        text[1] < '1' || text[1] > '8' || text[3] < '1' || text[3] > '8')
+    {
+        return 0;
+    }
+
+    int origin = (8 - (text[1] - '0')) * 8 + (text[0] - 'a');
+    int target = (8 - (text[3] - '0')) * 8 + (text[2] - 'a');
+    char promotion = '.';
+    if (text[4] != '\0' && text[4] != ' ' && text[4] != '\n')
+    {
+        promotion = game->is_white_turn ? toupper(text[4]) : tolower(text[4]);
+    }
+
+    Move moves[MAX_MOVES];
+    int count = generate_legal_moves(game, game->is_white_turn, moves);
+    for (int i = 0; i < count; i++)
+    {
+        if (moves[i].origin == origin && moves[i].target == target && moves[i].promotion_piece == promotion)
+        {
+            *out = moves[i];
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Score from the side to move's point of view, as UCI expects: "cp 35" or "mate 3"
+void format_uci_score(const Game *game, const SearchResult *line, char *text)
+{
+    int score = game->is_white_turn ? line->score : -line->score;
+    if (abs(score) >= MATE_IN_MAX_PLY)
+    {
+        int mate_in = (MATE_SCORE - abs(score) + 1) / 2;
+        sprintf(text, "mate %d", score > 0 ? mate_in : -mate_in);
+    }
+    else
+    {
+        sprintf(text, "cp %d", score);
+    }
+}
+
+// The line's moves separated by spaces (at least MAX_SEARCH_DEPTH * 6 + 1 bytes)
+static void format_line(const SearchResult *line, char *pv)
+{
+    char *c = pv;
+    for (int i = 0; i < line->length; i++)
+    {
+        if (i > 0)
+            *c++ = ' ';
+        move_to_uci(&line->moves[i], c);
+        c += strlen(c);
+    }
+    *c = '\0';
+}
+
+// One info line per line of the iteration, with "multipv <rank>" when there are several
+static void report_iteration(const SearchContext *context, void *user_data)
+{
+    const Game *root = (const Game *)user_data;
+    char score[32];
+    char pv[MAX_SEARCH_DEPTH * 6 + 1];
+    char rank[16] = "";
+
+    long long elapsed = current_time_ms() - context->start_time;
+    long long nps = elapsed > 0 ? context->positions_counted * 1000 / elapsed : 0;
+    for (int i = 0; i < context->num_pv_lines; i++)
+    {
+        if (context->num_pv_lines > 1)
+            sprintf(rank, " multipv %d", i + 1);
+        format_uci_score(root, &context->pv_lines[i], score);
+        format_line(&context->pv_lines[i], pv);
+        uci_send("info depth %d%s score %s nodes %lld nps %lld time %lld pv %s",
+                 context->depth_reached, rank, score, context->positions_counted, nps, elapsed, pv);
+    }
+}
+
+// An infinite or ponder search may end by itself, but its bestmove has to wait until the GUI asks
+static void wait_for_release(UciEngine *engine)
+{
+    pthread_mutex_lock(&engine->hold_lock);
+    while (engine->hold)
+        pthread_cond_wait(&engine->released, &engine->hold_lock);
+    pthread_mutex_unlock(&engine->hold_lock);
+}
+
+static void release_search(UciEngine *engine)
+{
+    pthread_mutex_lock(&engine->hold_lock);
+    engine->hold = 0;
+    pthread_cond_signal(&engine->released);
+    pthread_mutex_unlock(&engine->hold_lock);
+}
+
+static void *search_thread(void *argument)
+{
+    UciEngine *engine = (UciEngine *)argument;
+    Game game;
+    memcpy(&game, &engine->game, sizeof(Game));
+
+    char text[8];
+    Move best_move;
+    if (book_probe(engine->book, &game, &best_move))
+    {
+        wait_for_release(engine);
+        move_to_uci(&best_move, text);
+        uci_send("bestmove %s", text);
+        return NULL;
+    }
+
+    engine->context.on_iteration = report_iteration;
+    engine->context.user_data = &game;
+    int found = search_position(&game, &engine->context, &best_move);
+    wait_for_release(engine);
+    if (found)
+    {
+        uci_send("info string futility pruned %lld quiet moves, razored %lld positions", engine->context.futility_pruned,
+                 engine->context.razored);
+        move_to_uci(&best_move, text);
+        uci_send("bestmove %s", text);
+    }
+    else
+    {
+        uci_send("bestmove 0000");
+    }
+    return NULL;
+}
+
+static void stop_search(UciEngine *engine)
+{
+    if (!engine->searching)
+        return;
+
+    engine->context.stop = 1;
+    release_search(engine);
+    pthread_join(engine->thread, NULL);
+    engine->searching = 0;
+}
+
+// "position [startpos | fen <fen>] [moves <move>...]"
+static void set_position(UciEngine *engine, char *arguments)
+{
+    Game *game = &engine->game;
+    char *moves = strstr(arguments, "moves");
+    if (moves != NULL)
+        *(moves - 1) = '\0';
+
+    memset(game, 0, sizeof(Game));
+    const char *fen = START_FEN;
+    if (strncmp(arguments, "fen ", 4) == 0)
+        fen = arguments + 4;
+    if (!load_fen(game, fen))
+    {
+        uci_send("info string ERROR: invalid FEN, using the start position");
+        load_fen(game, START_FEN);
+    }
+
+    engine->history.count = 0;
+    game->random_seed = engine->random_seed++;
+    game->book = engine->book;
+    game->bitbases = engine->bitbases;
+
+    if (moves == NULL)
+        return;
+
+    for (char *token = strtok(moves + 5, " \t\r\n"); token != NULL; token = strtok(NULL, " \t\r\n"))
+    {
+        Move m;
+        if (!parse_uci_move(game, token, &m))
+        {
+            uci_send("info string ERROR: illegal move %s", token);
+            break;
+        }
+        key_history_push(&engine->history, game);
+        play_move(game, m.origin, m.target, m.promotion_piece);
+    }
+}
+
+// "go [depth N] [nodes N] [movetime ms] [wtime ms btime ms winc ms binc ms movestogo N] [infinite] [ponder]"
+static void start_search(UciEngine *engine, char *arguments)
+{
+    SearchLimits limits = {0, 0, 0};
+    long long time_left = 0, increment = 0;
+    int moves_to_go = 30;
+    int white = engine->game.is_white_turn;
+    int infinite = 0, ponder = 0;
+
+    for (char *token = strtok(arguments, " \t\r\n"); token != NULL; token = strtok(NULL, " \t\r\n"))
+    {
+        if (strcmp(token, "infinite") == 0 || strcmp(token, "ponder") == 0)
+        {
+            infinite |= token[0] == 'i';
+            ponder |= token[0] == 'p';
+            continue;
+        }
+        char *value = strtok(NULL, " \t\r\n");
+        if (value == NULL)
+            break;
+        if (strcmp(token, "depth") == 0)
+            limits.depth = atoi(value);
+        else if (strcmp(token, "nodes") == 0)
+            limits.nodes = atoll(value);
+        else if (strcmp(token, "movetime") == 0)
+            limits.move_time = atoi(value);
+        else if (strcmp(token, white ? "wtime" : "btime") == 0)
+            time_left = atoll(value);
+        else if (strcmp(token, white ? "winc" : "binc") == 0)
+            increment = atoll(value);
+        else if (strcmp(token, "movestogo") == 0 && atoi(value) > 0)
+            moves_to_go = atoi(value);
+    }
+
+    // With a clock, spend an even share of the remaining time plus most of the increment
+    if (limits.move_time == 0 && time_left > 0)
+    {
+        long long share = time_left / moves_to_go + increment * 3 / 4;
+        limits.move_time = (int)min((int)share, (int)(time_left / 2));
+        limits.move_time = max(limits.move_time, 1);
+    }
+
+    // A ponder search thinks on the opponent's time, its clock only starts with "ponderhit"
+    engine->ponder_time = 0;
+    if (ponder)
+    {
+        engine->ponder_time = limits.move_time;
+        limits.move_time = 0;
+    }
+    if (infinite)
+        limits = (SearchLimits){0, 0, 0};
+    engine->hold = infinite || ponder;
+
+    memset(&engine->context, 0, sizeof(SearchContext));
+    engine->context.limits = limits;
+    engine->context.params = engine->params;
+    engine->context.history = &engine->history;
+    engine->context.multi_pv = engine->multi_pv;
+    engine->context.tt = engine->tt;
+    engine->context.cache = engine->cache;
+    engine->searching = 1;
+    if (pthread_create(&engine->thread, NULL, search_thread, engine) != 0)
+    {
+        uci_send("info string ERROR: unable to start the search thread");
+        engine->searching = 0;
+        engine->hold = 0;
+    }
+}
+
+// "setoption name <name> value <value>"
+static void set_option(UciEngine *engine, char *arguments)
+{
+    char *name = strstr(arguments, "name ");
+    char *value = strstr(arguments, " value ");
+    if (name == NULL)
+        return;
+    name += 5;
+    if (value != NULL)
+    {
+        *value = '\0';
+        value += 7;
+        value[strcspn(value, "\r\n")] = '\0';
+    }
+    name[strcspn(name, "\r\n")] = '\0';
+
+    if (strcmp(name, "Hash") == 0 && value != NULL)
+    {
+        tt_free(engine->tt);
+        engine->tt = tt_create(max(atoi(value), 1));
+        if (engine->tt != NULL)
+            uci_send("info string hash %zu MB, %zu MB in huge pages", (engine->tt->mask + 1) * sizeof(TTEntry) >> 20,
+                     engine->tt->huge_bytes >> 20);
+    }
+    else if (strcmp(name, "CacheFile") == 0 && value != NULL)
+    {
+        analysis_cache_close(engine->cache);
+        engine->cache = strcmp(value, "<empty>") == 0 ? NULL : analysis_cache_open(value, engine->cache_size);
+        if (engine->cache != NULL)
+            engine->cache->min_depth = engine->cache_depth;
+    }
+    else if (strcmp(name, "CacheSize") == 0 && value != NULL)
+    {
+        engine->cache_size = max(atoi(value), 1);
+    }
+    else if (strcmp(name, "CacheDepth") == 0 && value != NULL)
+    {
+        engine->cache_depth = atoi(value);
+        if (engine->cache != NULL)
+            engine->cache->min_depth = engine->cache_depth;
+    }
+    else if (strcmp(name, "BookFile") == 0 && value != NULL)
+    {
+        book_close(engine->book);
+        engine->book = strcmp(value, "<empty>") == 0 ? NULL : book_open(value);
+        if (engine->book != NULL)
+        {
+            engine->book->max_ply = engine->book_depth;
+            engine->book->best_move_only = engine->book_best;
+        }
+    }
+    else if (strcmp(name, "BookDepth") == 0 && value != NULL)
+    {
+        engine->book_depth = atoi(value);
+        if (engine->book != NULL)
+            engine->book->max_ply = engine->book_depth;
+    }
+    else if (strcmp(name, "BookBest") == 0 && value != NULL)
+    {
+        engine->book_best = strcmp(value, "true") == 0;
+        if (engine->book != NULL)
+            engine->book->best_move_only = engine->book_best;
+    }
+    else if (strcmp(name, "MultiPV") == 0 && value != NULL)
+    {
+        engine->multi_pv = min(max(atoi(value), 1), MAX_MULTI_PV);
+    }
+    else if (strcmp(name, "FutilityMargin") == 0 && value != NULL)
+    {
+        engine->params.futility_margin = max(atoi(value), 0);
+    }
+    else if (strcmp(name, "RazorMargin") == 0 && value != NULL)
+    {
+        engine->params.razor_margin = max(atoi(value), 0);
+    }
+    else if (strcmp(name, "Bitbases") == 0 && value != NULL)
+    {
+        bitbases_close(engine->bitbases);
+        engine->bitbases = strcmp(value, "<empty>") == 0 ? NULL : bitbases_open(value);
+    }
+    else
+    {
+        uci_send("info string unknown option %s", name);
+    }
+    engine->game.book = engine->book;
+    engine->game.bitbases = engine->bitbases;
+}
+
+int uci_loop(void)
+{
+    static char line[65536];
+    char start_position[] = "startpos";
+    UciEngine engine;
+    memset(&engine, 0, sizeof(UciEngine));
+    engine.book_depth = DEFAULT_BOOK_DEPTH;
+    engine.random_seed = (unsigned int)time(NULL);
+    engine.tt = tt_create(DEFAULT_HASH_SIZE);
+    engine.cache_size = DEFAULT_CACHE_SIZE;
+    engine.cache_depth = DEFAULT_CACHE_DEPTH;
+    engine.params.futility_margin = DEFAULT_FUTILITY_MARGIN;
+    engine.params.razor_margin = DEFAULT_RAZOR_MARGIN;
+    engine.multi_pv = 1;
+    pthread_mutex_init(&engine.hold_lock, NULL);
+    pthread_cond_init(&engine.released, NULL);
+    set_position(&engine, start_position);
+
+    while (fgets(line, sizeof(line), stdin) != NULL)
+    {
+        char *command = line;
+        while (*command == ' ' || *command == '\t')
+            command++;
+        command[strcspn(command, "\r\n")] = '\0';
+
+        if (strcmp(command, "uci") == 0)
+        {
+            uci_send("id name publicChessEngine");
+            uci_send("id author yynill");
+            uci_send("option name Hash type spin default %d min 1 max 65536", DEFAULT_HASH_SIZE);
+            uci_send("option name CacheFile type string default <empty>");
+            uci_send("option name CacheSize type spin default %d min 1 max 65536", DEFAULT_CACHE_SIZE);
+            uci_send("option name CacheDepth type spin default %d min 1 max %d", DEFAULT_CACHE_DEPTH, MAX_SEARCH_DEPTH);
+            uci_send("option name BookFile type string default <empty>");
+            uci_send("option name BookDepth type spin default %d min 0 max 1000", DEFAULT_BOOK_DEPTH);
+            uci_send("option name BookBest type check default false");
+            uci_send("option name MultiPV type spin default 1 min 1 max %d", MAX_MULTI_PV);
+            uci_send("option name FutilityMargin type spin default %d min 0 max 1000", DEFAULT_FUTILITY_MARGIN);
+            uci_send("option name RazorMargin type spin default %d min 0 max 1000", DEFAULT_RAZOR_MARGIN);
+            uci_send("option name Bitbases type string default <empty>");
+            uci_send("uciok");
+        }
+        else if (strcmp(command, "isready") == 0)
+        {
+            uci_send("readyok");
+        }
+        else if (strcmp(command, "ucinewgame") == 0)
+        {
+            stop_search(&engine);
+            tt_clear(engine.tt);
+        }
+        else if (strncmp(command, "setoption", 9) == 0)
+        {
+            stop_search(&engine);
+            set_option(&engine, command + 9);
+        }
+        else if (strncmp(command, "position ", 9) == 0)
+        {
+            stop_search(&engine);
+            set_position(&engine, command + 9);
+        }
+        else if (strncmp(command, "go", 2) == 0)
+        {
+            stop_search(&engine);
+            start_search(&engine, command + 2);
+        }
+        else if (strcmp(command, "stop") == 0)
+        {
+            stop_search(&engine);
+        }
+        else if (strcmp(command, "ponderhit") == 0)
+        {
+            // the predicted move was played: the search goes on as a normal one, bestmove follows when it ends
+            if (engine.searching && engine.ponder_time > 0)
+                engine.context.limits.move_time = (int)(current_time_ms() - engine.context.start_time) + engine.ponder_time;
+            release_search(&engine);
+        }
+        else if (strcmp(command, "quit") == 0)
+        {
+            break;
+        }
+    }
+
+    stop_search(&engine);
+    tt_free(engine.tt);
+    analysis_cache_close(engine.cache);
+    book_close(engine.book);
+    bitbases_close(engine.bitbases);
+    pthread_mutex_destroy(&engine.hold_lock);
+    pthread_cond_destroy(&engine.released);
+    return 1;
+}
@@ -0,0 +1,66 @@
+#include "chessEngine.h"
+#include <unistd.h>
+
+// With the bitbases loaded the engine still has to mate: KQK self-play at depth 5 must end
+// in checkmate before the fifty-move rule draws it
+int main(void)
+{
+    char dir[] = "/tmp/bitbaseMate-XXXXXX";
+    if (mkdtemp(dir) == NULL || !generate_bitbases(dir, (int)sysconf(_SC_NPROCESSORS_ONLN)))
+    {
+        printf("FAIL: unable to generate the bitbases\n");
+        return 1;
+    }
+    Bitbases *bitbases = bitbases_open(dir);
+    TranspositionTable *tt = tt_create(16);
+    if (bitbases == NULL || tt == NULL)
+    {
+        printf("FAIL: unable to open the bitbases or create the transposition table\n");
+        return 1;
+    }
+
+    Game game;
+    memset(&game, 0, sizeof(Game));
+    load_fen(&game, "8/8/8/4k3/8/8/8/3QK3 w - - 0 1");
+    game.bitbases = bitbases;
+    KeyHistory history;
+    history.count = 0;
+
+    int ply = 0;
+    Move m;
+    while (game.halfmove_clock < 100)
+    {
+        SearchContext context;
+        memset(&context, 0, sizeof(SearchContext));
+        context.limits.depth = 5;
+        context.params.futility_margin = DEFAULT_FUTILITY_MARGIN;
+        context.params.razor_margin = DEFAULT_RAZOR_MARGIN;
+        context.tt = tt;
+        context.history = &history;
+        if (!search_position(&game, &context, &m))
+        {
+            break;
+        }
+        key_history_push(&history, &game);
+        play_move(&game, m.origin, m.target, m.promotion_piece);
+        ply++;
+    }
+
+    int mated = checkers(&game) != 0 && !has_legal_move(&game);
+    if (mated)
+        printf("mate after %d plies\n", ply);
+    else
+        printf("FAIL: no mate after %d plies (halfmove clock %d)\n", ply, game.halfmove_clock);
+
+    tt_free(tt);
+    bitbases_close(bitbases);
+    char path[512];
+    const char *names[] = {"kqk", "krk", "kpk", "kbnk"};
+    for (int i = 0; i < 4; i++)
+    {
+        snprintf(path, sizeof(path), "%s/%s.bb", dir, names[i]);
+        unlink(path);
+    }
+    rmdir(dir);
+    return mated ? 0 : 1;
+}
@@ -0,0 +1,38 @@
+#include "chessEngine.h"
+
+// position_key has to give the keys published with the Polyglot book format, or no
+// third-party book is ever found: the start position, after 1. e4, and after
+// 1. e4 d5 2. e5 f5 (an en passant capture is possible)
+int main(void)
+{
+    static const struct
+    {
+        const char *fen;
+        uint64_t key;
+    } reference[] = {
+        {"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 0x463B96181691FC9CULL},
+        {"rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1", 0x823C9B50FD114196ULL},
+        {"rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3", 0x22A48B5A8E47FF78ULL},
+    };
+
+    int failures = 0;
+    for (size_t i = 0; i < sizeof(reference) / sizeof(reference[0]); i++)
+    {
+        Game game;
+        memset(&game, 0, sizeof(Game));
+        if (!load_fen(&game, reference[i].fen))
+        {
+            printf("FAIL: invalid FEN %s\n", reference[i].fen);
+            failures++;
+            continue;
+        }
+        uint64_t key = position_key(&game);
+        if (key != reference[i].key)
+        {
+            printf("FAIL: %s has key %016llx, expected %016llx\n", reference[i].fen,
+                   (unsigned long long)key, (unsigned long long)reference[i].key);
+            failures++;
+        }
+    }
+    return failures == 0 ? 0 : 1;
+}